@@ -0,0 +1,24 @@
+#-------------------------------------------------
+#
+# Benchmarks of the interpolation kernels and of
+# whole unwraps on synthetic mirror images. Prints
+# the results as JSON. Not installed.
+#
+#-------------------------------------------------
+
+QT       += core gui
+
+TARGET = unwrap360-bench
+TEMPLATE = app
+
+CONFIG += console
+CONFIG -= app_bundle
+
+DESTDIR = build
+OBJECTS_DIR = $$DESTDIR
+MOC_DIR = $$DESTDIR
+
+CORE_OUT_PWD = ../core
+include(../core/core.pri)
+
+SOURCES += main.cpp
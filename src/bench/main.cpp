@@ -0,0 +1,553 @@
+/******************************************************************************
+ *
+ * Copyright (c) 2010 Cláudio F. Gil <claudio.f.gil@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+#include <QByteArray>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QImage>
+#include <QStringList>
+#include <QThread>
+#include <QVector>
+#include <qmath.h>
+
+#include <stdio.h>
+
+#include "interpolation.h"
+#include "unwrapmap.h"
+#include "unwrapper.h"
+
+static const char* usage =
+        "Usage: unwrap360-bench [options]\n"
+        "\n"
+        "Measures the interpolation kernels and whole unwraps on synthetic\n"
+        "mirror images and prints the results as JSON.\n"
+        "\n"
+        "  --quick                 only the smallest source and output\n"
+        "  --repeat N              runs of each case, the best is kept (default: 3)\n"
+        "  --samples N             samples per kernel run (default: 1000000)\n"
+        "  --threads N             threads per unwrap (default: one per core)\n"
+        "  --output FILE           write the JSON there instead of stdout\n"
+        "  --help\n";
+
+struct BenchOptions
+{
+    BenchOptions() :
+        quick(false), repeat(3), samples(1000000), threads(0)
+    {
+    }
+
+    bool quick;
+    int repeat;
+    int samples;
+    int threads;
+    QString output;
+};
+
+struct SourceSize
+{
+    const char* name;
+    int width;
+    int height;
+};
+
+static const SourceSize sourceSizes[] = {
+    { "2MP", 1632, 1224 },
+    { "12MP", 4000, 3000 },
+    { "40MP", 7728, 5152 }
+};
+
+static const int finalWidths[] = { 3000, 8000 };
+
+struct KernelSource
+{
+    const char* name;
+    int width;
+    int height;
+    bool wholeMap;
+};
+
+/**
+ * Sources the kernels are timed on. The row kernels are meant to be at
+ * least four times as fast as the qreal bilinear on the large one, so it
+ * is sampled through its whole map instead of --samples pixels.
+ */
+static const KernelSource kernelSources[] = {
+    { "2MP", 1632, 1224, false },
+    { "4000x4000", 4000, 4000, true }
+};
+
+/**
+ * Mirror geometry used for a source: centered, as most rigs are, with the
+ * ring taking most of the short side.
+ */
+static void mirrorGeometry(const QSize& size, QPointF& center, qreal& innerRadius, qreal& outerRadius)
+{
+    qreal side = qMin(size.width(), size.height());
+
+    center = QPointF(size.width() / 2.0, size.height() / 2.0);
+    innerRadius = side * 0.15;
+    outerRadius = side * 0.45;
+}
+
+/**
+ * Source with a ring of hue changing with the angle and brightness with the
+ * radius, plus a checker pattern so neighbouring pixels differ like in a
+ * real photo.
+ */
+static QImage syntheticMirror(int width, int height)
+{
+    QImage image(width, height, QImage::Format_RGB32);
+
+    QPointF center;
+    qreal innerRadius, outerRadius;
+    mirrorGeometry(image.size(), center, innerRadius, outerRadius);
+
+    for (int y = 0; y < height; y++) {
+        QRgb* line = (QRgb*) image.scanLine(y);
+        qreal dy = y - center.y();
+
+        for (int x = 0; x < width; x++) {
+            qreal dx = x - center.x();
+            qreal r = qSqrt(dx * dx + dy * dy);
+
+            if (r < innerRadius || r > outerRadius) {
+                line[x] = qRgb(16, 16, 16);
+                continue;
+            }
+
+            qreal angle = qAtan2(dy, dx);
+            int v = 64 + int(191 * (r - innerRadius) / (outerRadius - innerRadius));
+            int checker = ((x >> 3) ^ (y >> 3)) & 1 ? 24 : 0;
+
+            line[x] = qRgb(qBound(0, int(v * (0.5 + 0.5 * qCos(angle))) + checker, 255),
+                           qBound(0, int(v * (0.5 + 0.5 * qSin(angle))) + checker, 255),
+                           qBound(0, v - checker, 255));
+        }
+    }
+
+    return image;
+}
+
+static double bestOf(const QVector<qint64>& runs)
+{
+    qint64 best = runs.first();
+    foreach (qint64 run, runs) {
+        best = qMin(best, run);
+    }
+
+    return best;
+}
+
+/**
+ * Keeps the results of a kernel from being optimized away.
+ */
+static volatile QRgb sink;
+
+/**
+ * Result of a kernel on source. Bilinear kernels also give their speedup
+ * over baseline, the nanoseconds per sample of the qreal bilinear.
+ */
+static QString kernelResult(const char* name, const char* api, const KernelSource& source, int samples,
+                            const QVector<qint64>& runs, double baseline)
+{
+    // nanoseconds per sample are also milliseconds per million samples
+    double ns = bestOf(runs) / samples;
+
+    QString speedup;
+    if (qstrcmp(name, "bilinear") == 0) {
+        speedup = QString(", \"speedup\": %1").arg(baseline / ns, 0, 'f', 2);
+    }
+
+    return QString("    { \"kernel\": \"%1\", \"api\": \"%2\", \"source\": \"%3\", \"samples\": %4, "
+                   "\"ms_per_million\": %5, \"msamples_per_s\": %6%7 }")
+            .arg(name).arg(api).arg(source.name).arg(samples)
+            .arg(ns, 0, 'f', 3).arg(1000.0 / ns, 0, 'f', 1).arg(speedup);
+}
+
+/**
+ * Runs a row kernel over the rows of map until samples pixels are done.
+ */
+static qint64 timeRowKernel(InterpolationRowFunction function, const QImage& source,
+                            const UnwrapMap& map, int samples)
+{
+    const QRgb* pixels = (const QRgb*) source.bits();
+    int stride = source.bytesPerLine() / sizeof(QRgb);
+    QVector<QRgb> output(map.width());
+
+    QElapsedTimer timer;
+    timer.start();
+
+    int y = 0;
+    for (int done = 0; done < samples; done += map.width()) {
+        int count = qMin(map.width(), samples - done);
+        function(pixels, stride, map.row(y), output.data(), count);
+        y = (y + 1) % map.height();
+    }
+
+    qint64 elapsed = timer.nsecsElapsed();
+    sink = output.at(0);
+
+    return elapsed;
+}
+
+typedef QRgb (*InterpolationFunction)(const QRgb* pixels, int width, const QPointF& point);
+
+/**
+ * The bilinear interpolation unwraps used before the row kernels, one
+ * pixel per call in qreal. Kept as the baseline they are measured against.
+ */
+static QRgb qrealBilinearInterpolation(const QRgb* pixels, int width, const QPointF& point)
+{
+    QPoint p = point.toPoint();
+
+    int x = p.x();
+    int y = p.y();
+
+    qreal dx = qAbs(point.x() - x);
+    qreal dy = qAbs(point.y() - y);
+
+    int pos00 =  y * width +  x;
+    int pos01 = pos00 + width;
+    int pos10 = pos00 + 1;
+    int pos11 = pos01 + 1;
+
+    QRgb rgb00 = pixels[pos00];
+    QRgb rgb10 = pixels[pos10];
+    QRgb rgb01 = pixels[pos01];
+    QRgb rgb11 = pixels[pos11];
+
+    qreal f00 = (1-dx)*(1-dy);
+    qreal f10 =    dx *(1-dy);
+    qreal f01 = (1-dx)*   dy;
+    qreal f11 =    dx *   dy;
+
+    int r = qRed  (rgb00)*f00 + qRed  (rgb10)*f10 + qRed  (rgb01)*f01 + qRed  (rgb11)*f11;
+    int g = qGreen(rgb00)*f00 + qGreen(rgb10)*f10 + qGreen(rgb01)*f01 + qGreen(rgb11)*f11;
+    int b = qBlue (rgb00)*f00 + qBlue (rgb10)*f10 + qBlue (rgb01)*f01 + qBlue (rgb11)*f11;
+
+    return qRgb(r, g, b);
+}
+
+static qint64 timePointKernel(InterpolationFunction function, const QImage& source,
+                              const UnwrapMap& map, int samples)
+{
+    const QRgb* pixels = (const QRgb*) source.bits();
+    int stride = source.bytesPerLine() / sizeof(QRgb);
+    QRgb result = 0;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    int x = 0;
+    int y = 0;
+    for (int done = 0; done < samples; done++) {
+        result ^= function(pixels, stride, map.point(x, y));
+
+        if (++x == map.width()) {
+            x = 0;
+            y = (y + 1) % map.height();
+        }
+    }
+
+    qint64 elapsed = timer.nsecsElapsed();
+    sink = result;
+
+    return elapsed;
+}
+
+static QStringList benchKernels(const BenchOptions& options)
+{
+    struct PointKernel {
+        const char* name;
+        const char* api;
+        InterpolationFunction function;
+    };
+
+    struct RowKernel {
+        const char* name;
+        const char* api;
+        InterpolationRowFunction function;
+        bool available;
+    };
+
+    PointKernel pointKernels[] = {
+        { "identity", "point", identityInterpolation },
+        { "bilinear", "point", bilinearInterpolation },
+        { "bicubic", "point", bicubicInterpolation }
+    };
+
+    RowKernel rowKernels[] = {
+        { "identity", "row", identityInterpolationRow, true },
+        { "bilinear", "row", bilinearInterpolationRow, true },
+        { "bilinear", "row-generic", bilinearInterpolationRowGeneric, true },
+#ifdef UNWRAP360_X86
+        { "bilinear", "row-sse2", bilinearInterpolationRowSse2, cpuHasSse2() },
+        { "bilinear", "row-avx2", bilinearInterpolationRowAvx2, cpuHasAvx2() },
+#endif
+        { "bicubic", "row", bicubicInterpolationRow, true },
+        { "bicubic", "row-generic", bicubicInterpolationRowGeneric, true },
+#ifdef UNWRAP360_X86
+        { "bicubic", "row-sse2", bicubicInterpolationRowSse2, cpuHasSse2() },
+#endif
+    };
+
+    int sourceCount = options.quick ? 1 : sizeof(kernelSources) / sizeof(kernelSources[0]);
+
+    QStringList results;
+
+    for (int s = 0; s < sourceCount; s++) {
+        const KernelSource& size = kernelSources[s];
+        QImage source = syntheticMirror(size.width, size.height);
+
+        QPointF center;
+        qreal innerRadius, outerRadius;
+        mirrorGeometry(source.size(), center, innerRadius, outerRadius);
+
+        QSize unwrapped = Unwrapper::unwrappedSize(innerRadius, outerRadius, 35, 120);
+        UnwrapMap map;
+        map.build(center, innerRadius, outerRadius, unwrapped.width(), unwrapped.height(), true);
+
+        int samples = size.wholeMap ? map.width() * map.height() : options.samples;
+
+        QVector<qint64> runs;
+        for (int r = 0; r < options.repeat; r++) {
+            runs.append(timePointKernel(qrealBilinearInterpolation, source, map, samples));
+        }
+
+        double baseline = bestOf(runs) / samples;
+        results.append(kernelResult("bilinear", "point-qreal", size, samples, runs, baseline));
+
+        for (unsigned i = 0; i < sizeof(pointKernels) / sizeof(pointKernels[0]); i++) {
+            runs.clear();
+            for (int r = 0; r < options.repeat; r++) {
+                runs.append(timePointKernel(pointKernels[i].function, source, map, samples));
+            }
+
+            results.append(kernelResult(pointKernels[i].name, pointKernels[i].api, size, samples, runs, baseline));
+        }
+
+        for (unsigned i = 0; i < sizeof(rowKernels) / sizeof(rowKernels[0]); i++) {
+            if (!rowKernels[i].available) {
+                continue;
+            }
+
+            runs.clear();
+            for (int r = 0; r < options.repeat; r++) {
+                runs.append(timeRowKernel(rowKernels[i].function, source, map, samples));
+            }
+
+            results.append(kernelResult(rowKernels[i].name, rowKernels[i].api, size, samples, runs, baseline));
+        }
+    }
+
+    return results;
+}
+
+static const char* interpolationName(Unwrapper::Interpolation interpolation)
+{
+    switch (interpolation) {
+    case Unwrapper::NoInterpolation:
+        return "identity";
+    case Unwrapper::BilinearInterpolation:
+        return "bilinear";
+    case Unwrapper::BicubicInterpolation:
+        return "bicubic";
+    case Unwrapper::AreaInterpolation:
+        return "area";
+    case Unwrapper::UserInterpolation:
+        break;
+    }
+
+    return "unknown";
+}
+
+static QStringList benchUnwraps(const BenchOptions& options)
+{
+    Unwrapper::Interpolation interpolations[] = {
+        Unwrapper::BilinearInterpolation,
+        Unwrapper::BicubicInterpolation,
+        Unwrapper::AreaInterpolation
+    };
+
+    int sourceCount = options.quick ? 1 : sizeof(sourceSizes) / sizeof(sourceSizes[0]);
+    int finalCount = options.quick ? 1 : sizeof(finalWidths) / sizeof(finalWidths[0]);
+
+    QStringList results;
+
+    for (int s = 0; s < sourceCount; s++) {
+        const SourceSize& size = sourceSizes[s];
+        QImage source = syntheticMirror(size.width, size.height);
+
+        UnwrapParameters parameters;
+        mirrorGeometry(source.size(), parameters.center, parameters.innerRadius, parameters.outerRadius);
+        parameters.threadCount = options.threads;
+
+        for (int f = 0; f < finalCount; f++) {
+            parameters.finalWidth = finalWidths[f];
+
+            for (unsigned i = 0; i < sizeof(interpolations) / sizeof(interpolations[0]); i++) {
+                parameters.interpolation = interpolations[i];
+
+                for (int singlePass = 0; singlePass < 2; singlePass++) {
+                    parameters.singlePass = singlePass;
+
+                    // area averaging always samples at the final size
+                    if (!singlePass && parameters.samplesFinalSize()) {
+                        continue;
+                    }
+
+                    // the map is built before timing, as it is reused between images
+                    Unwrapper unwrapper;
+                    unwrapper.setParameters(parameters);
+                    QSize finalSize = unwrapper.unwrap(source).size();
+
+                    QVector<qint64> runs;
+                    for (int r = 0; r < options.repeat; r++) {
+                        QElapsedTimer timer;
+                        timer.start();
+                        unwrapper.unwrap(source);
+                        runs.append(timer.nsecsElapsed());
+                    }
+
+                    results.append(QString("    { \"source\": \"%1\", \"source_width\": %2, \"source_height\": %3, "
+                                           "\"final_width\": %4, \"final_height\": %5, \"interpolation\": \"%6\", "
+                                           "\"single_pass\": %7, \"threads\": %8, \"ms\": %9 }")
+                                   .arg(size.name).arg(size.width).arg(size.height)
+                                   .arg(finalSize.width()).arg(finalSize.height())
+                                   .arg(interpolationName(parameters.interpolation))
+                                   .arg(singlePass ? "true" : "false")
+                                   .arg(unwrapper.threadCount())
+                                   .arg(bestOf(runs) / 1e6, 0, 'f', 2));
+                }
+            }
+        }
+    }
+
+    return results;
+}
+
+static const char* simdName()
+{
+#ifdef UNWRAP360_X86
+    if (cpuHasAvx2()) {
+        return "avx2";
+    }
+    if (cpuHasSse2()) {
+        return "sse2";
+    }
+#endif
+    return "generic";
+}
+
+static bool parseArguments(const QStringList& arguments, BenchOptions& options, QString& error)
+{
+    for (int i = 1; i < arguments.size(); i++) {
+        QString argument = arguments.at(i);
+
+        if (argument == "--quick") {
+            options.quick = true;
+            continue;
+        }
+
+        if (i + 1 >= arguments.size()) {
+            error = QString("unknown option %1").arg(argument);
+            return false;
+        }
+
+        QString value = arguments.at(++i);
+        bool ok = true;
+
+        if (argument == "--repeat") {
+            options.repeat = value.toInt(&ok);
+            ok = ok && options.repeat > 0;
+        }
+        else if (argument == "--samples") {
+            options.samples = value.toInt(&ok);
+            ok = ok && options.samples > 0;
+        }
+        else if (argument == "--threads") {
+            options.threads = value.toInt(&ok);
+        }
+        else if (argument == "--output") {
+            options.output = value;
+        }
+        else {
+            error = QString("unknown option %1").arg(argument);
+            return false;
+        }
+
+        if (!ok) {
+            error = QString("invalid value for %1: %2").arg(argument).arg(value);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+
+    QStringList arguments = a.arguments();
+    if (arguments.contains("--help") || arguments.contains("-h")) {
+        fputs(usage, stdout);
+        return 0;
+    }
+
+    BenchOptions options;
+    QString error;
+
+    if (!parseArguments(arguments, options, error)) {
+        fprintf(stderr, "unwrap360-bench: %s\n\n%s", qPrintable(error), usage);
+        return 2;
+    }
+
+    QStringList kernels = benchKernels(options);
+    QStringList unwraps = benchUnwraps(options);
+
+    QString json = QString("{\n"
+                           "  \"version\": 2,\n"
+                           "  \"qt\": \"%1\",\n"
+                           "  \"simd\": \"%2\",\n"
+                           "  \"cores\": %3,\n"
+                           "  \"repeat\": %4,\n"
+                           "  \"kernels\": [\n%5\n  ],\n"
+                           "  \"unwrap\": [\n%6\n  ]\n"
+                           "}\n")
+            .arg(qVersion()).arg(simdName()).arg(QThread::idealThreadCount()).arg(options.repeat)
+            .arg(kernels.join(",\n")).arg(unwraps.join(",\n"));
+
+    if (options.output.isEmpty()) {
+        fputs(json.toUtf8().constData(), stdout);
+        return 0;
+    }
+
+    QFile file(options.output);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(json.toUtf8()) < 0) {
+        fprintf(stderr, "unwrap360-bench: cannot write %s\n", qPrintable(options.output));
+        return 1;
+    }
+
+    return 0;
+}
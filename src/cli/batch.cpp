@@ -0,0 +1,377 @@
+/******************************************************************************
+ *
+ * Copyright (c) 2010 Cláudio F. Gil <claudio.f.gil@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+
+#include <QDir>
+#include <QFileInfo>
+#include <QImageWriter>
+#include <QRunnable>
+#include <QSettings>
+#include <QElapsedTimer>
+#include <QMutexLocker>
+#include <QThread>
+
+#include <stdio.h>
+
+#include "batch.h"
+#include "sourcereader.h"
+#include "mirrordetector.h"
+#include "videoio.h"
+#include "videopipeline.h"
+#include "unwrapsink.h"
+#include "imageencoder.h"
+
+BatchOptions::BatchOptions() :
+    hasCenter(false),
+    detect(false),
+    format("jpg"),
+    quality(90),
+    compression(6),
+    suffix("-unwrapped"),
+    stream(false),
+    video(false),
+    videoFormat("mp4"),
+    frameRate(25),
+    track(false),
+    trackThreshold(0.5),
+    jobs(2),
+    mapCache(MapCache::defaultDirectory()),
+    mapCacheSize(MapCache::DefaultMaxSize)
+{
+}
+
+/**
+ * Reads options from an ini file. The [Processing] group uses the same keys
+ * the application saves its settings with, and [Geometry] has centerX,
+ * centerY, inner and outer in source pixels.
+ */
+bool BatchOptions::loadPreset(const QString& path)
+{
+    if (!QFileInfo(path).isReadable()) {
+        return false;
+    }
+
+    QSettings preset(path, QSettings::IniFormat);
+
+    UnwrapParameters& p = parameters;
+
+    preset.beginGroup("Geometry");
+    if (preset.contains("centerX") && preset.contains("centerY")) {
+        p.center = QPointF(preset.value("centerX").toDouble(), preset.value("centerY").toDouble());
+        hasCenter = true;
+    }
+    p.innerRadius = preset.value("inner", p.innerRadius).toDouble();
+    p.outerRadius = preset.value("outer", p.outerRadius).toDouble();
+    preset.endGroup();
+
+    preset.beginGroup("Processing");
+    p.fov = preset.value("fov", p.fov).toInt();
+    p.focalPointPercent = preset.value("focalPercent", p.focalPointPercent).toInt();
+    p.interpolation = (Unwrapper::Interpolation) preset.value("interpolationOption", (int) p.interpolation).toInt();
+    p.equiRectangular = preset.value("equiRectangular", p.equiRectangular).toBool();
+    p.finalWidth = preset.value("finalWidth", p.finalWidth).toInt();
+    p.finalHeight = preset.value("finalHeight", p.finalHeight).toInt();
+    p.invert = preset.value("invert", p.invert).toBool();
+    p.threadCount = preset.value("threads", p.threadCount).toInt();
+    p.singlePass = preset.value("singlePass", p.singlePass).toBool();
+    preset.endGroup();
+
+    preset.beginGroup("Output");
+    format = preset.value("format", format).toString();
+    quality = preset.value("quality", quality).toInt();
+    compression = preset.value("compression", compression).toInt();
+    stream = preset.value("stream", stream).toBool();
+    videoFormat = preset.value("videoFormat", videoFormat).toString();
+    preset.endGroup();
+
+    return preset.status() == QSettings::NoError;
+}
+
+/**
+ * Unwraps a single file. Runs in the pool of the batch.
+ */
+class UnwrapFile : public QRunnable
+{
+public:
+    UnwrapFile(Batch* batch, const QString& path) :
+        m_batch(batch), m_path(path)
+    {
+    }
+
+    void run()
+    {
+        const BatchOptions& options = m_batch->options();
+
+        QElapsedTimer timer;
+        timer.start();
+
+        // only the square around the mirror is decoded
+        SourceReader reader(m_path);
+        QSize sourceSize = reader.size();
+        UnwrapParameters parameters = m_batch->parameters(sourceSize);
+
+        // the jobs share the cores, each detecting, sampling and encoding
+        // with its part of them
+        if (parameters.threadCount <= 0) {
+            parameters.threadCount = qMax(1, QThread::idealThreadCount() / qMax(1, options.jobs));
+        }
+
+        if (options.detect) {
+            MirrorDetector detector;
+            detector.setThreadCount(parameters.threadCount);
+            if (!detector.detect(m_path)) {
+                m_batch->fail(QString("%1: no mirror found").arg(m_path));
+                return;
+            }
+
+            detector.apply(parameters);
+        }
+
+        QImage source;
+        if (!reader.read(parameters, source)) {
+            m_batch->fail(QString("%1: failed to load image: %2").arg(m_path).arg(reader.errorString()));
+            return;
+        }
+
+        Unwrapper unwrapper;
+        unwrapper.setParameters(parameters);
+
+        QString output = m_batch->outputPath(m_path, options.format);
+
+        if (options.stream) {
+            UnwrapSink* sink = UnwrapSink::create(output, options.format, options.quality);
+            bool ok = unwrapper.unwrap(source, sink);
+            QString error = sink->errorString();
+            delete sink;
+
+            if (!ok) {
+                m_batch->fail(QString("%1: failed to write %2: %3").arg(m_path).arg(output).arg(error));
+                return;
+            }
+        }
+        else {
+            UnwrapMap map = m_batch->map(sourceSize, parameters);
+            if (map.isNull()) {
+                m_batch->fail(QString("%1: nothing to unwrap with the given radii").arg(m_path));
+                return;
+            }
+
+            QImage result = unwrapper.unwrap(source, map);
+            source = QImage();
+            qint64 unwrapTime = timer.restart();
+
+            ImageEncoder encoder;
+            encoder.setFormat(options.format);
+            encoder.setQuality(options.quality);
+            encoder.setCompression(options.compression);
+            encoder.setThreadCount(parameters.threadCount);
+
+            if (!encoder.save(result, output)) {
+                m_batch->fail(QString("%1: failed to save %2: %3").arg(m_path).arg(output).arg(encoder.errorString()));
+                return;
+            }
+
+            m_batch->report(QString("%1 -> %2 (%3 ms, saved in %4 ms)")
+                            .arg(m_path).arg(output).arg(unwrapTime).arg(timer.elapsed()));
+            return;
+        }
+
+        m_batch->report(QString("%1 -> %2 (%3 ms)").arg(m_path).arg(output).arg(timer.elapsed()));
+    }
+
+private:
+    Batch* m_batch;
+    QString m_path;
+};
+
+Batch::Batch(const BatchOptions& options) :
+    m_options(options),
+    m_mapCache(options.mapCache),
+    m_failures(0)
+{
+    m_pool.setMaxThreadCount(qMax(1, m_options.jobs));
+    m_mapCache.setMaxSize(qint64(m_options.mapCacheSize) * 1024 * 1024);
+}
+
+const BatchOptions& Batch::options() const
+{
+    return m_options;
+}
+
+/**
+ * Unwraps all files and waits for them. Returns false if any failed.
+ */
+bool Batch::run(const QStringList& files)
+{
+    m_failures = 0;
+
+    foreach (const QString& file, files) {
+        m_pool.start(new UnwrapFile(this, file));
+    }
+
+    m_pool.waitForDone();
+
+    return m_failures == 0;
+}
+
+/**
+ * Unwraps videos one after the other, each using all the cores. An input
+ * directory is read as a sequence of frames in name order. When the video
+ * format is an image format, frames are written as numbered images in a
+ * directory instead of being encoded.
+ */
+bool Batch::runVideos(const QStringList& inputs)
+{
+    m_failures = 0;
+
+    QString format = m_options.videoFormat.toLower();
+    bool imageOutput = QImageWriter::supportedImageFormats().contains(format.toLatin1());
+
+    foreach (const QString& input, inputs) {
+        FrameReader* reader;
+        if (QFileInfo(input).isDir()) {
+            QDir dir(input);
+            QStringList files;
+            foreach (const QFileInfo& file, dir.entryInfoList(QDir::Files, QDir::Name)) {
+                files.append(file.filePath());
+            }
+
+            reader = new ImageSequenceReader(files, m_options.frameRate);
+        }
+        else {
+            reader = new FfmpegReader(input);
+        }
+
+        FrameWriter* writer;
+        QString output;
+        if (imageOutput) {
+            output = outputPath(input, QString());
+            writer = new ImageSequenceWriter(output, format, m_options.quality);
+        }
+        else {
+            output = outputPath(input, format);
+            writer = new FfmpegWriter(output, m_options.quality);
+        }
+
+        if (!reader->open()) {
+            fail(QString("%1: %2").arg(input).arg(reader->errorString()));
+        }
+        else {
+            VideoPipeline pipeline(reader, writer);
+            pipeline.setParameters(parameters(reader->frameSize()));
+            pipeline.setMapCache(&m_mapCache);
+            pipeline.setWorkerCount(m_options.parameters.threadCount);
+            pipeline.setTracking(m_options.track);
+            pipeline.setTrackingThreshold(m_options.trackThreshold);
+
+            if (pipeline.run()) {
+                QString message = QString("%1 -> %2 (%3 frames, %4 fps").arg(input).arg(output)
+                        .arg(pipeline.frameCount()).arg(pipeline.framesPerSecond(), 0, 'f', 1);
+                if (m_options.track) {
+                    message += QString(", %1 map updates").arg(pipeline.mapUpdates());
+                }
+
+                report(message + ")");
+            }
+            else {
+                fail(QString("%1: %2").arg(input).arg(pipeline.errorString()));
+            }
+        }
+
+        delete writer;
+        delete reader;
+    }
+
+    return m_failures == 0;
+}
+
+/**
+ * Parameters for sources of the given size, with the center filled in.
+ */
+UnwrapParameters Batch::parameters(const QSize& sourceSize) const
+{
+    UnwrapParameters p = m_options.parameters;
+    if (!m_options.hasCenter) {
+        p.center = QPointF(sourceSize.width() / 2.0, sourceSize.height() / 2.0);
+    }
+
+    return p;
+}
+
+/**
+ * Map for sources of the given size, shared by all files of that size.
+ * The parameters are those moved to the decoded part of such a source.
+ * Maps of detected mirrors are built for each file.
+ */
+UnwrapMap Batch::map(const QSize& sourceSize, const UnwrapParameters& p)
+{
+    QSize size = p.mapSize();
+
+    // detected mirrors differ from one image to the next, not worth keeping
+    if (m_options.detect) {
+        UnwrapMap map;
+        map.build(p.center, p.innerRadius, p.outerRadius,
+                  size.width(), size.height(), p.invert);
+        return map;
+    }
+
+    QMutexLocker locker(&m_mapsMutex);
+
+    QPair<int, int> key(sourceSize.width(), sourceSize.height());
+    if (m_maps.contains(key)) {
+        return m_maps.value(key);
+    }
+
+    UnwrapMap map = m_mapCache.map(p);
+
+    m_maps.insert(key, map);
+    return map;
+}
+
+/**
+ * Output file for input: same name plus the suffix, in the output directory
+ * or next to the input, with the extension of format. Without a format it
+ * names a directory.
+ */
+QString Batch::outputPath(const QString& input, const QString& format) const
+{
+    QFileInfo info(QDir::cleanPath(input));
+    QDir dir = m_options.outputDir.isEmpty() ? info.dir() : QDir(m_options.outputDir);
+    QString name = info.completeBaseName() + m_options.suffix;
+
+    return dir.filePath(format.isEmpty() ? name : name + "." + format);
+}
+
+void Batch::report(const QString& message, bool error)
+{
+    QMutexLocker locker(&m_reportMutex);
+
+    FILE* stream = error ? stderr : stdout;
+    fprintf(stream, "%s\n", qPrintable(message));
+    fflush(stream);
+}
+
+void Batch::fail(const QString& message)
+{
+    m_failures.ref();
+    report(message, true);
+}
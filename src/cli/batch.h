@@ -0,0 +1,106 @@
+/******************************************************************************
+ *
+ * Copyright (c) 2010 Cláudio F. Gil <claudio.f.gil@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <QMap>
+#include <QMutex>
+#include <QPair>
+#include <QStringList>
+#include <QThreadPool>
+#include <QAtomicInt>
+
+#include "unwrapmap.h"
+#include "unwrapper.h"
+#include "mapcache.h"
+
+/**
+ * Everything needed to unwrap a set of images without asking anyone.
+ * Defaults are the same as the ones of the settings dialog. Without an
+ * explicit center, the mirror is assumed to be in the middle of each image,
+ * unless it is detected in each of them.
+ */
+struct BatchOptions
+{
+    BatchOptions();
+
+    bool loadPreset(const QString& path);
+
+    UnwrapParameters parameters;
+    bool hasCenter;
+    bool detect;
+
+    QString format;
+    int quality;
+    int compression;
+    QString outputDir;
+    QString suffix;
+    bool stream;
+
+    bool video;
+    QString videoFormat;
+    qreal frameRate;
+    bool track;
+    qreal trackThreshold;
+
+    int jobs;
+
+    QString mapCache;
+    int mapCacheSize;
+};
+
+/**
+ * Unwraps a list of files, several at a time. Files of the same size share
+ * the same UnwrapMap, which is only built once, or loaded from the map
+ * cache when an earlier run built it.
+ */
+class Batch
+{
+public:
+    explicit Batch(const BatchOptions& options);
+
+    bool run(const QStringList& files);
+    bool runVideos(const QStringList& inputs);
+
+    const BatchOptions& options() const;
+    UnwrapParameters parameters(const QSize& sourceSize) const;
+    UnwrapMap map(const QSize& sourceSize, const UnwrapParameters& parameters);
+    QString outputPath(const QString& input, const QString& format) const;
+
+    void report(const QString& message, bool error = false);
+    void fail(const QString& message);
+
+private:
+    BatchOptions m_options;
+    QThreadPool m_pool;
+
+    QMutex m_mapsMutex;
+    QMap<QPair<int, int>, UnwrapMap> m_maps;
+    MapCache m_mapCache;
+
+    QMutex m_reportMutex;
+    QAtomicInt m_failures;
+};
+
+#endif // BATCH_H
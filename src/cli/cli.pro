@@ -0,0 +1,38 @@
+#-------------------------------------------------
+#
+# Command line tool to unwrap images in batch,
+# without a display.
+#
+#-------------------------------------------------
+
+QT       += core gui
+
+TARGET = unwrap360-cli
+TEMPLATE = app
+
+CONFIG += console
+CONFIG -= app_bundle
+
+DESTDIR = build
+OBJECTS_DIR = $$DESTDIR
+MOC_DIR = $$DESTDIR
+
+CORE_OUT_PWD = ../core
+include(../core/core.pri)
+
+SOURCES += main.cpp \
+    batch.cpp
+
+HEADERS += batch.h
+
+#
+# Install
+#
+
+INSTALLS += target
+
+isEmpty(PREFIX) {
+    PREFIX = /usr
+}
+
+target.path = $$PREFIX/bin
@@ -0,0 +1,343 @@
+/******************************************************************************
+ *
+ * Copyright (c) 2010 Cláudio F. Gil <claudio.f.gil@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+
+#include <QCoreApplication>
+#include <QStringList>
+#include <QFileInfo>
+#include <QDir>
+
+#include <stdio.h>
+
+#include "batch.h"
+#include "unwrapsink.h"
+
+static const char* usage =
+        "Usage: unwrap360-cli [options] image...\n"
+        "\n"
+        "Unwraps 360 degree images taken with a mirror into rectangular ones.\n"
+        "Images may be given as wildcards, e.g. 'shots/*.jpg'.\n"
+        "\n"
+        "Geometry, in source pixels:\n"
+        "  --center X,Y            center of the mirror (default: image center)\n"
+        "  --inner R               inner radius\n"
+        "  --outer R               outer radius\n"
+        "  --detect                find the center and radii in each image,\n"
+        "                          overriding the options above\n"
+        "\n"
+        "Processing:\n"
+        "  --fov DEG               vertical field of view (default: 120)\n"
+        "  --focal PERCENT         focal point between the radii (default: 35)\n"
+        "  --interpolation NAME    nearest, bilinear, bicubic or area, which\n"
+        "                          averages and samples at the final size\n"
+        "                          (default: bilinear)\n"
+        "  --width PX              final width (default: 3000)\n"
+        "  --height PX             final height (default: from width and fov)\n"
+        "  --equirectangular       pad to 180 degrees (default)\n"
+        "  --no-equirectangular\n"
+        "  --sky-up                sky is up (default)\n"
+        "  --sky-down\n"
+        "  --single-pass           sample at the final size, using less memory\n"
+        "\n"
+        "Output:\n"
+        "  --format EXT            jpg, png, tif, ... (default: jpg)\n"
+        "  --quality N             0 to 100, for jpg (default: 90)\n"
+        "  --compression N         0 to 9, for png and tif, where 0 leaves tif\n"
+        "                          uncompressed (default: 6)\n"
+        "  --output-dir DIR        where to save (default: next to each image)\n"
+        "  --suffix TEXT           added to the file names (default: -unwrapped)\n"
+        "  --stream                encode while unwrapping, band by band, to keep\n"
+        "                          memory low; jpg or ppm only, implies a single pass\n"
+        "\n"
+        "Video:\n"
+        "  --video                 inputs are videos, or directories of frames;\n"
+        "                          needs the ffmpeg tool for video files\n"
+        "  --video-format EXT      mp4, mkv, avi, ... or an image format to write\n"
+        "                          numbered frames (default: mp4)\n"
+        "  --frame-rate FPS        rate of directories of frames (default: 25)\n"
+        "  --track                 follow the mirror as the rig moves, from the\n"
+        "                          geometry above\n"
+        "  --track-threshold PX    movement that rebuilds the map (default: 0.5)\n"
+        "\n"
+        "Execution:\n"
+        "  --jobs N                images processed at the same time (default: 2)\n"
+        "  --threads N             threads per image, or frames unwrapped at the\n"
+        "                          same time for videos (default: cores / jobs)\n"
+        "  --preset FILE           ini file with [Geometry], [Processing] and\n"
+        "                          [Output] groups; later options override it\n"
+        "  --map-cache DIR         where built maps are kept for the next runs\n"
+        "                          (default: the user cache directory)\n"
+        "  --map-cache-size MB     size of the map cache (default: 512)\n"
+        "  --no-map-cache          always build the maps\n"
+        "  --help\n";
+
+static bool parseInterpolation(const QString& name, Unwrapper::Interpolation& interpolation)
+{
+    bool isNumber = false;
+    int number = name.toInt(&isNumber);
+
+    const Sampler* sampler = isNumber ? findSampler(number) : findSampler(name);
+    if (!sampler) {
+        return false;
+    }
+
+    interpolation = (Unwrapper::Interpolation) sampler->interpolation;
+    return true;
+}
+
+/**
+ * Wildcards are expanded here because not every shell does it.
+ */
+static QStringList expandInput(const QString& input)
+{
+    if (!input.contains('*') && !input.contains('?') && !input.contains('[')) {
+        return QStringList(input);
+    }
+
+    QFileInfo info(input);
+    QStringList files;
+
+    foreach (const QFileInfo& file, info.dir().entryInfoList(QStringList(info.fileName()), QDir::Files, QDir::Name)) {
+        files.append(file.filePath());
+    }
+
+    return files;
+}
+
+static bool parseArguments(const QStringList& arguments, BatchOptions& options, QStringList& inputs, QString& error)
+{
+    for (int i = 1; i < arguments.size(); i++) {
+        QString argument = arguments.at(i);
+
+        if (!argument.startsWith("--")) {
+            inputs += expandInput(argument);
+            continue;
+        }
+
+        QString value;
+        int equals = argument.indexOf('=');
+        if (equals > 0) {
+            value = argument.mid(equals + 1);
+            argument = argument.left(equals);
+        }
+
+        // flags
+        if (argument == "--equirectangular") {
+            options.parameters.equiRectangular = true;
+            continue;
+        }
+        else if (argument == "--no-equirectangular") {
+            options.parameters.equiRectangular = false;
+            continue;
+        }
+        else if (argument == "--sky-up") {
+            options.parameters.invert = true;
+            continue;
+        }
+        else if (argument == "--sky-down") {
+            options.parameters.invert = false;
+            continue;
+        }
+        else if (argument == "--single-pass") {
+            options.parameters.singlePass = true;
+            continue;
+        }
+        else if (argument == "--stream") {
+            options.stream = true;
+            continue;
+        }
+        else if (argument == "--video") {
+            options.video = true;
+            continue;
+        }
+        else if (argument == "--track") {
+            options.track = true;
+            continue;
+        }
+        else if (argument == "--detect") {
+            options.detect = true;
+            continue;
+        }
+        else if (argument == "--no-map-cache") {
+            options.mapCache.clear();
+            continue;
+        }
+
+        // options with a value
+        if (equals < 0) {
+            if (i + 1 >= arguments.size()) {
+                error = QString("missing value for %1").arg(argument);
+                return false;
+            }
+
+            value = arguments.at(++i);
+        }
+
+        bool ok = true;
+
+        if (argument == "--center") {
+            QStringList xy = value.split(',');
+            bool okY = false;
+            ok = xy.size() == 2;
+            if (ok) {
+                options.parameters.center = QPointF(xy.at(0).toDouble(&ok), xy.at(1).toDouble(&okY));
+                ok = ok && okY;
+                options.hasCenter = true;
+            }
+        }
+        else if (argument == "--inner") {
+            options.parameters.innerRadius = value.toDouble(&ok);
+        }
+        else if (argument == "--outer") {
+            options.parameters.outerRadius = value.toDouble(&ok);
+        }
+        else if (argument == "--fov") {
+            options.parameters.fov = value.toInt(&ok);
+        }
+        else if (argument == "--focal") {
+            options.parameters.focalPointPercent = value.toInt(&ok);
+        }
+        else if (argument == "--interpolation") {
+            ok = parseInterpolation(value, options.parameters.interpolation);
+        }
+        else if (argument == "--width") {
+            options.parameters.finalWidth = value.toInt(&ok);
+        }
+        else if (argument == "--height") {
+            options.parameters.finalHeight = value.toInt(&ok);
+        }
+        else if (argument == "--format") {
+            options.format = value.toLower();
+        }
+        else if (argument == "--quality") {
+            options.quality = value.toInt(&ok);
+        }
+        else if (argument == "--compression") {
+            options.compression = value.toInt(&ok);
+            ok = ok && options.compression >= 0 && options.compression <= 9;
+        }
+        else if (argument == "--output-dir") {
+            options.outputDir = value;
+        }
+        else if (argument == "--suffix") {
+            options.suffix = value;
+        }
+        else if (argument == "--video-format") {
+            options.videoFormat = value.toLower();
+        }
+        else if (argument == "--frame-rate") {
+            options.frameRate = value.toDouble(&ok);
+            ok = ok && options.frameRate > 0;
+        }
+        else if (argument == "--track-threshold") {
+            options.trackThreshold = value.toDouble(&ok);
+            ok = ok && options.trackThreshold >= 0;
+        }
+        else if (argument == "--jobs") {
+            options.jobs = value.toInt(&ok);
+        }
+        else if (argument == "--threads") {
+            options.parameters.threadCount = value.toInt(&ok);
+        }
+        else if (argument == "--preset") {
+            ok = options.loadPreset(value);
+        }
+        else if (argument == "--map-cache") {
+            options.mapCache = value;
+        }
+        else if (argument == "--map-cache-size") {
+            options.mapCacheSize = value.toInt(&ok);
+            ok = ok && options.mapCacheSize > 0;
+        }
+        else {
+            error = QString("unknown option %1").arg(argument);
+            return false;
+        }
+
+        if (!ok) {
+            error = QString("invalid value for %1: %2").arg(argument).arg(value);
+            return false;
+        }
+    }
+
+    // detected radii replace the given ones, which may be left out; videos
+    // aren't detected and always need them
+    bool detected = options.detect && !options.video;
+    if (!detected && (options.parameters.innerRadius < 0
+                      || options.parameters.outerRadius <= options.parameters.innerRadius)) {
+        error = "the outer radius must be larger than the inner radius";
+        return false;
+    }
+
+    if (options.parameters.finalWidth <= 0) {
+        error = "the final width must be positive";
+        return false;
+    }
+
+    if (options.stream && !UnwrapSink::canStream(options.format)) {
+        error = QString("%1 can't be streamed").arg(options.format);
+        return false;
+    }
+
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication::setOrganizationName("Unrap360");
+    QCoreApplication::setApplicationName("unrap360");
+
+    QCoreApplication a(argc, argv);
+
+    QStringList arguments = a.arguments();
+    if (arguments.contains("--help") || arguments.contains("-h")) {
+        fputs(usage, stdout);
+        return 0;
+    }
+
+    BatchOptions options;
+    QStringList inputs;
+    QString error;
+
+    if (!parseArguments(arguments, options, inputs, error)) {
+        fprintf(stderr, "unwrap360-cli: %s\n\n%s", qPrintable(error), usage);
+        return 2;
+    }
+
+    if (inputs.isEmpty()) {
+        fprintf(stderr, "unwrap360-cli: no images to unwrap\n\n%s", usage);
+        return 2;
+    }
+
+    if (!options.outputDir.isEmpty() && !QDir().mkpath(options.outputDir)) {
+        fprintf(stderr, "unwrap360-cli: cannot create %s\n", qPrintable(options.outputDir));
+        return 2;
+    }
+
+    Batch batch(options);
+
+    if (options.video) {
+        return batch.runVideos(inputs) ? 0 : 1;
+    }
+
+    return batch.run(inputs) ? 0 : 1;
+}
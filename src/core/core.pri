@@ -0,0 +1,16 @@
+#
+# Links a project with the unwrapping engine built by core.pro.
+# Set CORE_OUT_PWD to the build directory of core.pro, relative
+# to the OUT_PWD of the project, before including this file.
+#
+
+include($$PWD/../profile.pri)
+include($$PWD/jpeg.pri)
+
+INCLUDEPATH += $$PWD
+DEPENDPATH += $$PWD
+
+isEmpty(CORE_OUT_PWD): error("CORE_OUT_PWD must be set before including core.pri")
+
+LIBS += -L$$OUT_PWD/$$CORE_OUT_PWD/build -lunwrap360core
+PRE_TARGETDEPS += $$OUT_PWD/$$CORE_OUT_PWD/build/libunwrap360core.a
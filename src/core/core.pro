@@ -0,0 +1,56 @@
+#-------------------------------------------------
+#
+# Unwrapping engine, shared by the application and
+# the command line tool. It must not depend on
+# widgets.
+#
+#-------------------------------------------------
+
+QT       += core gui
+
+TARGET = unwrap360core
+TEMPLATE = lib
+
+CONFIG += staticlib
+
+DESTDIR = build
+OBJECTS_DIR = build
+MOC_DIR = build
+
+include(../profile.pri)
+include(jpeg.pri)
+
+SOURCES += \
+    framequeue.cpp \
+    imageencoder.cpp \
+    interpolation.cpp \
+    interpolation_x86.cpp \
+    jpegsink.cpp \
+    mapcache.cpp \
+    mirrordetector.cpp \
+    mirrortracker.cpp \
+    polarbuffer.cpp \
+    sourcepyramid.cpp \
+    sourcereader.cpp \
+    unwrapmap.cpp \
+    unwrapper.cpp \
+    unwrapsink.cpp \
+    videoio.cpp \
+    videopipeline.cpp
+
+HEADERS += \
+    framequeue.h \
+    imageencoder.h \
+    interpolation.h \
+    jpegsink.h \
+    mapcache.h \
+    mirrordetector.h \
+    mirrortracker.h \
+    polarbuffer.h \
+    sourcepyramid.h \
+    sourcereader.h \
+    unwrapmap.h \
+    unwrapper.h \
+    unwrapsink.h \
+    videoio.h \
+    videopipeline.h
@@ -0,0 +1,76 @@
+/******************************************************************************
+ *
+ * Copyright (c) 2010 Cláudio F. Gil <claudio.f.gil@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+#include <QMutexLocker>
+
+#include "framequeue.h"
+
+FrameQueue::FrameQueue(int capacity) :
+    m_capacity(qMax(1, capacity)),
+    m_closed(false)
+{
+}
+
+bool FrameQueue::push(const VideoFrame& frame)
+{
+    QMutexLocker locker(&m_mutex);
+
+    while (!m_closed && m_frames.size() >= m_capacity) {
+        m_notFull.wait(&m_mutex);
+    }
+
+    if (m_closed) {
+        return false;
+    }
+
+    m_frames.enqueue(frame);
+    m_notEmpty.wakeOne();
+
+    return true;
+}
+
+bool FrameQueue::pop(VideoFrame& frame)
+{
+    QMutexLocker locker(&m_mutex);
+
+    while (!m_closed && m_frames.isEmpty()) {
+        m_notEmpty.wait(&m_mutex);
+    }
+
+    if (m_frames.isEmpty()) {
+        return false;
+    }
+
+    frame = m_frames.dequeue();
+    m_notFull.wakeOne();
+
+    return true;
+}
+
+void FrameQueue::close()
+{
+    QMutexLocker locker(&m_mutex);
+
+    m_closed = true;
+    m_notEmpty.wakeAll();
+    m_notFull.wakeAll();
+}
@@ -0,0 +1,72 @@
+/******************************************************************************
+ *
+ * Copyright (c) 2010 Cláudio F. Gil <claudio.f.gil@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+#ifndef FRAMEQUEUE_H
+#define FRAMEQUEUE_H
+
+#include <QImage>
+#include <QMutex>
+#include <QQueue>
+#include <QWaitCondition>
+
+#include "unwrapmap.h"
+
+/**
+ * A frame of a video, its position in it and the map to unwrap it with.
+ */
+struct VideoFrame
+{
+    VideoFrame() : index(-1) {}
+    VideoFrame(int i, const QImage& img, const UnwrapMap& m) : index(i), image(img), map(m) {}
+
+    int index;
+    QImage image;
+    UnwrapMap map;
+};
+
+/**
+ * Bounded queue between two stages of the video pipeline. Producers block
+ * while it is full and consumers while it is empty, so a slow stage holds
+ * back the ones before it instead of letting frames pile up in memory.
+ *
+ * Closing the queue wakes everyone: push() fails from then on and pop()
+ * fails once the remaining frames are taken.
+ */
+class FrameQueue
+{
+public:
+    explicit FrameQueue(int capacity);
+
+    bool push(const VideoFrame& frame);
+    bool pop(VideoFrame& frame);
+    void close();
+
+private:
+    QMutex m_mutex;
+    QWaitCondition m_notEmpty;
+    QWaitCondition m_notFull;
+    QQueue<VideoFrame> m_frames;
+    int m_capacity;
+    bool m_closed;
+};
+
+#endif // FRAMEQUEUE_H
@@ -0,0 +1,681 @@
+/******************************************************************************
+ *
+ * Copyright (c) 2010 Cláudio F. Gil <claudio.f.gil@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+
+#include <QAtomicInt>
+#include <QDataStream>
+#include <QFile>
+#include <QFileInfo>
+#include <QImageWriter>
+#include <QRunnable>
+#include <QThread>
+#include <QVector>
+
+#include "imageencoder.h"
+
+#ifdef UNWRAP360_JPEG
+
+#include <stdio.h>
+#include <setjmp.h>
+
+extern "C" {
+#include <jpeglib.h>
+}
+
+/**
+ * libjpeg exits the process on errors unless error_exit jumps back out.
+ */
+struct StripeError
+{
+    jpeg_error_mgr manager;
+    jmp_buf jump;
+    char message[JMSG_LENGTH_MAX];
+};
+
+/**
+ * libjpeg destination appending to a byte array.
+ */
+struct StripeDestination
+{
+    jpeg_destination_mgr manager;
+    QByteArray* data;
+    JOCTET buffer[16384];
+};
+
+extern "C" {
+static void stripeErrorExit(j_common_ptr info)
+{
+    StripeError* error = (StripeError*) info->err;
+    (*info->err->format_message)(info, error->message);
+    longjmp(error->jump, 1);
+}
+
+static void stripeInitDestination(j_compress_ptr info)
+{
+    StripeDestination* destination = (StripeDestination*) info->dest;
+    destination->manager.next_output_byte = destination->buffer;
+    destination->manager.free_in_buffer = sizeof(destination->buffer);
+}
+
+static boolean stripeEmptyBuffer(j_compress_ptr info)
+{
+    StripeDestination* destination = (StripeDestination*) info->dest;
+    destination->data->append((const char*) destination->buffer, sizeof(destination->buffer));
+    destination->manager.next_output_byte = destination->buffer;
+    destination->manager.free_in_buffer = sizeof(destination->buffer);
+    return TRUE;
+}
+
+static void stripeTermDestination(j_compress_ptr info)
+{
+    StripeDestination* destination = (StripeDestination*) info->dest;
+    destination->data->append((const char*) destination->buffer,
+                              sizeof(destination->buffer) - destination->manager.free_in_buffer);
+}
+}
+
+/**
+ * Compresses rows firstRow to firstRow + rows - 1 of image as a JPEG of its
+ * own. Every stripe gets the same default tables, so their scans can be
+ * joined, and a stripe that is restartRows MCU rows high is exactly one
+ * restart interval.
+ */
+static bool encodeStripe(const QImage& image, int firstRow, int rows, int quality, int restartRows,
+                         QByteArray* data, QString* error)
+{
+    jpeg_compress_struct info;
+    StripeError jpegError;
+    StripeDestination destination;
+    QByteArray line(3 * image.width(), 0);
+
+    info.err = jpeg_std_error(&jpegError.manager);
+    jpegError.manager.error_exit = stripeErrorExit;
+    jpeg_create_compress(&info);
+
+    if (setjmp(jpegError.jump)) {
+        *error = jpegError.message;
+        jpeg_destroy_compress(&info);
+        return false;
+    }
+
+    destination.data = data;
+    destination.manager.init_destination = stripeInitDestination;
+    destination.manager.empty_output_buffer = stripeEmptyBuffer;
+    destination.manager.term_destination = stripeTermDestination;
+    info.dest = &destination.manager;
+
+    info.image_width = image.width();
+    info.image_height = rows;
+    info.input_components = 3;
+    info.in_color_space = JCS_RGB;
+
+    jpeg_set_defaults(&info);
+    jpeg_set_quality(&info, quality, TRUE);
+    info.restart_in_rows = restartRows;
+    jpeg_start_compress(&info, TRUE);
+
+    JSAMPROW row = (JSAMPROW) line.data();
+    int width = image.width();
+
+    for (int y = firstRow; y < firstRow + rows; y++) {
+        const QRgb* pixels = (const QRgb*) image.scanLine(y);
+        JSAMPLE* sample = row;
+
+        for (int x = 0; x < width; x++) {
+            *sample++ = qRed(pixels[x]);
+            *sample++ = qGreen(pixels[x]);
+            *sample++ = qBlue(pixels[x]);
+        }
+
+        jpeg_write_scanlines(&info, &row, 1);
+    }
+
+    jpeg_finish_compress(&info);
+    jpeg_destroy_compress(&info);
+
+    return true;
+}
+
+/**
+ * Offset of the entropy coded data of jpeg, just after the header of its
+ * scan, or -1 if there is none. heightOffset gets where the frame header
+ * keeps the number of rows.
+ */
+static int scanOffset(const QByteArray& jpeg, int* heightOffset)
+{
+    const uchar* bytes = (const uchar*) jpeg.constData();
+    int size = jpeg.size();
+
+    // markers after the start of image, each followed by its length
+    for (int i = 2; i + 4 <= size && bytes[i] == 0xff; ) {
+        int marker = bytes[i + 1];
+        int length = (bytes[i + 2] << 8) | bytes[i + 3];
+
+        if (marker >= 0xc0 && marker <= 0xc2) {
+            *heightOffset = i + 5;
+        }
+        else if (marker == 0xda) {
+            return i + 2 + length;
+        }
+
+        i += 2 + length;
+    }
+
+    return -1;
+}
+
+/**
+ * Worker that keeps encoding the next free stripe until none is left.
+ */
+class EncodeStripes : public QRunnable
+{
+public:
+    EncodeStripes(const QImage* image, int stripeRows, int quality, int restartRows,
+                  QByteArray* stripes, QString* errors, int count, QAtomicInt* nextStripe) :
+        m_image(image), m_stripeRows(stripeRows), m_quality(quality), m_restartRows(restartRows),
+        m_stripes(stripes), m_errors(errors), m_count(count), m_nextStripe(nextStripe)
+    {
+    }
+
+    void run()
+    {
+        for (;;) {
+            int stripe = m_nextStripe->fetchAndAddOrdered(1);
+            if (stripe >= m_count) {
+                break;
+            }
+
+            int firstRow = stripe * m_stripeRows;
+            int rows = qMin(m_stripeRows, m_image->height() - firstRow);
+            encodeStripe(*m_image, firstRow, rows, m_quality, m_restartRows,
+                         &m_stripes[stripe], &m_errors[stripe]);
+        }
+    }
+
+private:
+    const QImage* m_image;
+    int m_stripeRows;
+    int m_quality;
+    int m_restartRows;
+    QByteArray* m_stripes;
+    QString* m_errors;
+    int m_count;
+    QAtomicInt* m_nextStripe;
+};
+
+#endif // UNWRAP360_JPEG
+
+/**
+ * Tile of image with its top left corner at left, top, as interleaved RGB
+ * samples. Tiles on the right and bottom edges are padded to full size.
+ * When compressed, each sample is stored as the difference from the one of
+ * the pixel to its left, which deflate packs much better.
+ */
+static QByteArray encodeTile(const QImage& image, int left, int top, int level)
+{
+    int size = ImageEncoder::TileSize;
+    QByteArray tile(3 * size * size, 0);
+
+    int right = qMin(left + size, image.width());
+    int bottom = qMin(top + size, image.height());
+
+    for (int y = top; y < bottom; y++) {
+        const QRgb* pixels = (const QRgb*) image.scanLine(y);
+        uchar* samples = (uchar*) tile.data() + 3 * size * (y - top);
+        QRgb previous = 0;
+
+        for (int x = left; x < right; x++) {
+            QRgb pixel = pixels[x];
+
+            if (level > 0) {
+                *samples++ = qRed(pixel) - qRed(previous);
+                *samples++ = qGreen(pixel) - qGreen(previous);
+                *samples++ = qBlue(pixel) - qBlue(previous);
+                previous = pixel;
+            }
+            else {
+                *samples++ = qRed(pixel);
+                *samples++ = qGreen(pixel);
+                *samples++ = qBlue(pixel);
+            }
+        }
+    }
+
+    if (level <= 0) {
+        return tile;
+    }
+
+    // qCompress puts the uncompressed size in front of the zlib stream
+    return qCompress(tile, level).mid(4);
+}
+
+/**
+ * Worker that keeps encoding the next free tile of a row of tiles until
+ * none is left.
+ */
+class EncodeTiles : public QRunnable
+{
+public:
+    EncodeTiles(const QImage* image, int top, int level,
+                QByteArray* tiles, int count, QAtomicInt* nextTile) :
+        m_image(image), m_top(top), m_level(level),
+        m_tiles(tiles), m_count(count), m_nextTile(nextTile)
+    {
+    }
+
+    void run()
+    {
+        for (;;) {
+            int tile = m_nextTile->fetchAndAddOrdered(1);
+            if (tile >= m_count) {
+                break;
+            }
+
+            m_tiles[tile] = encodeTile(*m_image, tile * ImageEncoder::TileSize, m_top, m_level);
+        }
+    }
+
+private:
+    const QImage* m_image;
+    int m_top;
+    int m_level;
+    QByteArray* m_tiles;
+    int m_count;
+    QAtomicInt* m_nextTile;
+};
+
+enum TiffType {
+    TiffShort = 3,
+    TiffLong = 4
+};
+
+static void writeTiffEntry(QDataStream& out, int tag, TiffType type, int count, quint32 value)
+{
+    out << quint16(tag) << quint16(type) << quint32(count);
+
+    // values that fit are kept in the entry, aligned to its start
+    if (type == TiffShort && count == 1) {
+        out << quint16(value) << quint16(0);
+    }
+    else {
+        out << value;
+    }
+}
+
+ImageEncoder::ImageEncoder() :
+    m_quality(90),
+    m_compression(6),
+    m_threadCount(0)
+{
+}
+
+/**
+ * Format to save in, as a file extension. When empty, the extension of the
+ * path given to save() is used.
+ */
+QString ImageEncoder::format() const
+{
+    return m_format;
+}
+
+void ImageEncoder::setFormat(const QString& format)
+{
+    m_format = format.toLower();
+}
+
+/**
+ * Quality of lossy formats, from 0 to 100.
+ */
+int ImageEncoder::quality() const
+{
+    return m_quality;
+}
+
+void ImageEncoder::setQuality(int quality)
+{
+    m_quality = qBound(0, quality, 100);
+}
+
+/**
+ * zlib level of PNG and TIFF, from 0, which leaves TIFF uncompressed, to 9.
+ */
+int ImageEncoder::compression() const
+{
+    return m_compression;
+}
+
+void ImageEncoder::setCompression(int compression)
+{
+    m_compression = qBound(0, compression, 9);
+}
+
+/**
+ * Number of threads used to compress. Zero means one per core.
+ */
+int ImageEncoder::threadCount() const
+{
+    return m_threadCount;
+}
+
+void ImageEncoder::setThreadCount(int threads)
+{
+    m_threadCount = qMax(0, threads);
+}
+
+int ImageEncoder::threads() const
+{
+    return m_threadCount > 0 ? m_threadCount : qMax(1, QThread::idealThreadCount());
+}
+
+QString ImageEncoder::errorString() const
+{
+    return m_errorString;
+}
+
+/**
+ * Formats written by the encoder itself, in the order the settings dialog
+ * lists them. Anything else QImageWriter supports is saved through it.
+ */
+QStringList ImageEncoder::formats()
+{
+    return QStringList() << "jpg" << "png" << "tif";
+}
+
+/**
+ * Writes image to path. JPEG and TIFF keep no alpha channel.
+ */
+bool ImageEncoder::save(const QImage& image, const QString& path)
+{
+    m_errorString = QString();
+
+    if (image.isNull()) {
+        m_errorString = "there is no image to save";
+        return false;
+    }
+
+    QString format = m_format.isEmpty() ? QFileInfo(path).suffix().toLower() : m_format;
+    bool jpeg = format == "jpg" || format == "jpeg";
+    bool tiff = format == "tif" || format == "tiff";
+
+    QImage pixels = image;
+    if ((jpeg || tiff) && pixels.format() != QImage::Format_RGB32 && pixels.format() != QImage::Format_ARGB32) {
+        pixels = pixels.convertToFormat(QImage::Format_RGB32);
+    }
+
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        m_errorString = file.errorString();
+        return false;
+    }
+
+    bool saved;
+    if (jpeg) {
+        saved = saveJpeg(pixels, file);
+    }
+    else if (tiff) {
+        saved = saveTiff(pixels, file);
+    }
+    else {
+        saved = saveWithWriter(pixels, file, format);
+    }
+
+    file.close();
+
+    if (saved && file.error() != QFile::NoError) {
+        m_errorString = file.errorString();
+        saved = false;
+    }
+
+    if (!saved) {
+        file.remove();
+    }
+
+    return saved;
+}
+
+/**
+ * Encodes horizontal stripes of the image in parallel and joins them into
+ * a single baseline JPEG. Each stripe is a whole restart interval, so only
+ * the header of the first is kept, with its height set to the full one,
+ * and the scans of the others follow it separated by restart markers.
+ */
+bool ImageEncoder::saveJpeg(const QImage& image, QFile& file)
+{
+#ifdef UNWRAP360_JPEG
+    if (image.width() > 65500 || image.height() > 65500) {
+        m_errorString = "the image is too large for JPEG";
+        return false;
+    }
+
+    // libjpeg subsamples chroma by two both ways, making MCUs 16 pixels
+    // wide and high, and a restart interval can't be over 65535 MCUs
+    int mcusPerRow = (image.width() + 15) / 16;
+    int mcuRows = qMin(StripeRows / 16, 65535 / mcusPerRow);
+    int threads = this->threads();
+
+    // small images still go to every thread
+    mcuRows = qMax(1, qMin(mcuRows, (image.height() + 15) / 16 / threads));
+
+    int stripeRows = 16 * mcuRows;
+    int count = (image.height() + stripeRows - 1) / stripeRows;
+    int restartRows = count > 1 ? mcuRows : 0;
+    threads = qMin(threads, count);
+
+    QVector<QByteArray> stripes(count);
+    QVector<QString> errors(count);
+    QAtomicInt nextStripe(0);
+    m_pool.setMaxThreadCount(threads);
+
+    for (int i = 1; i < threads; i++) {
+        m_pool.start(new EncodeStripes(&image, stripeRows, m_quality, restartRows,
+                                       stripes.data(), errors.data(), count, &nextStripe));
+    }
+
+    EncodeStripes(&image, stripeRows, m_quality, restartRows,
+                  stripes.data(), errors.data(), count, &nextStripe).run();
+    m_pool.waitForDone();
+
+    for (int k = 0; k < count; k++) {
+        if (!errors.at(k).isEmpty()) {
+            m_errorString = errors.at(k);
+            return false;
+        }
+    }
+
+    for (int k = 0; k < count; k++) {
+        QByteArray& stripe = stripes[k];
+        int heightOffset = -1;
+        int scan = scanOffset(stripe, &heightOffset);
+        int end = stripe.size() - 2;
+
+        if (scan < 0 || heightOffset < 0 || end < scan || !stripe.endsWith("\xff\xd9")) {
+            m_errorString = "unexpected stream from libjpeg";
+            return false;
+        }
+
+        bool written;
+        if (k == 0) {
+            stripe[heightOffset] = char(image.height() >> 8);
+            stripe[heightOffset + 1] = char(image.height() & 0xff);
+            written = file.write(stripe.constData(), end) == end;
+        }
+        else {
+            const char marker[2] = { char(0xff), char(0xd0 + (k - 1) % 8) };
+            written = file.write(marker, 2) == 2
+                    && file.write(stripe.constData() + scan, end - scan) == end - scan;
+        }
+
+        stripe = QByteArray();
+
+        if (!written) {
+            m_errorString = file.errorString();
+            return false;
+        }
+    }
+
+    if (file.write("\xff\xd9", 2) != 2) {
+        m_errorString = file.errorString();
+        return false;
+    }
+
+    return true;
+#else
+    return saveWithWriter(image, file, "jpg");
+#endif
+}
+
+/**
+ * Writes a little endian TIFF of TileSize square RGB tiles, deflated
+ * unless the compression is zero. Each row of tiles is compressed in
+ * parallel and written before the next, and the directory goes at the end.
+ * Tiles are written without libtiff, so any Qt build can save them.
+ */
+bool ImageEncoder::saveTiff(const QImage& image, QFile& file)
+{
+    int width = image.width();
+    int height = image.height();
+    int across = (width + TileSize - 1) / TileSize;
+    int down = (height + TileSize - 1) / TileSize;
+    int tileCount = across * down;
+    int level = m_compression;
+
+    QDataStream out(&file);
+    out.setByteOrder(QDataStream::LittleEndian);
+
+    // the offset of the directory is filled in at the end
+    out.writeRawData("II", 2);
+    out << quint16(42) << quint32(0);
+
+    QVector<quint32> offsets;
+    QVector<quint32> byteCounts;
+    QVector<QByteArray> tiles(across);
+    qint64 position = 8;
+
+    int threads = qMin(this->threads(), across);
+    m_pool.setMaxThreadCount(threads);
+
+    for (int row = 0; row < down; row++) {
+        QAtomicInt nextTile(0);
+        int top = row * TileSize;
+
+        for (int i = 1; i < threads; i++) {
+            m_pool.start(new EncodeTiles(&image, top, level, tiles.data(), across, &nextTile));
+        }
+
+        EncodeTiles(&image, top, level, tiles.data(), across, &nextTile).run();
+        m_pool.waitForDone();
+
+        for (int i = 0; i < across; i++) {
+            const QByteArray& tile = tiles.at(i);
+
+            if (file.write(tile) != tile.size()) {
+                m_errorString = file.errorString();
+                return false;
+            }
+
+            offsets << quint32(position);
+            byteCounts << quint32(tile.size());
+            position += tile.size();
+        }
+
+        if (position > Q_INT64_C(0xffffffff)) {
+            m_errorString = "the image is too large for TIFF";
+            return false;
+        }
+    }
+
+    // the directory starts on a word boundary
+    if (position % 2) {
+        out << quint8(0);
+        position++;
+    }
+
+    int entries = level > 0 ? 12 : 11;
+    qint64 directory = position;
+    qint64 bitsPerSample = directory + 2 + 12 * entries + 4;
+    qint64 offsetsAt = bitsPerSample + 6;
+    qint64 byteCountsAt = offsetsAt + 4 * tileCount;
+
+    if (byteCountsAt + 4 * tileCount > Q_INT64_C(0xffffffff)) {
+        m_errorString = "the image is too large for TIFF";
+        return false;
+    }
+
+    out << quint16(entries);
+    writeTiffEntry(out, 256, TiffLong, 1, width);
+    writeTiffEntry(out, 257, TiffLong, 1, height);
+    writeTiffEntry(out, 258, TiffShort, 3, bitsPerSample);
+    writeTiffEntry(out, 259, TiffShort, 1, level > 0 ? 8 : 1);
+    writeTiffEntry(out, 262, TiffShort, 1, 2);
+    writeTiffEntry(out, 277, TiffShort, 1, 3);
+    writeTiffEntry(out, 284, TiffShort, 1, 1);
+    if (level > 0) {
+        writeTiffEntry(out, 317, TiffShort, 1, 2);
+    }
+    writeTiffEntry(out, 322, TiffLong, 1, TileSize);
+    writeTiffEntry(out, 323, TiffLong, 1, TileSize);
+    writeTiffEntry(out, 324, TiffLong, tileCount, tileCount == 1 ? offsets.at(0) : offsetsAt);
+    writeTiffEntry(out, 325, TiffLong, tileCount, tileCount == 1 ? byteCounts.at(0) : byteCountsAt);
+    out << quint32(0);
+
+    out << quint16(8) << quint16(8) << quint16(8);
+    foreach (quint32 offset, offsets) {
+        out << offset;
+    }
+    foreach (quint32 byteCount, byteCounts) {
+        out << byteCount;
+    }
+
+    if (!file.seek(4)) {
+        m_errorString = file.errorString();
+        return false;
+    }
+
+    out << quint32(directory);
+
+    if (out.status() != QDataStream::Ok || file.error() != QFile::NoError) {
+        m_errorString = file.errorString();
+        return false;
+    }
+
+    return true;
+}
+
+bool ImageEncoder::saveWithWriter(const QImage& image, QFile& file, const QString& format)
+{
+    QImageWriter writer(&file, format.toLatin1());
+
+    if (format == "png") {
+        // Qt maps qualities 0 to 100 to zlib levels 9 to 0
+        writer.setQuality(100 - (91 * m_compression + 8) / 9);
+    }
+    else {
+        writer.setQuality(m_quality);
+    }
+
+    if (!writer.write(image)) {
+        m_errorString = writer.errorString();
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,82 @@
+/******************************************************************************
+ *
+ * Copyright (c) 2010 Cláudio F. Gil <claudio.f.gil@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+#ifndef IMAGEENCODER_H
+#define IMAGEENCODER_H
+
+#include <QImage>
+#include <QString>
+#include <QStringList>
+#include <QThreadPool>
+
+class QFile;
+
+/**
+ * Saves whole images using every core. JPEG is encoded in horizontal
+ * stripes that are joined with restart markers, and TIFF is written in
+ * deflated tiles; both are compressed in parallel. Other formats go through
+ * QImageWriter. A failed save leaves no partial file behind.
+ */
+class ImageEncoder
+{
+public:
+    ImageEncoder();
+
+    enum {
+        // rows of a JPEG stripe, a multiple of the 16 rows of an MCU
+        StripeRows = 512,
+        // side of a TIFF tile, which must be a multiple of 16
+        TileSize = 256
+    };
+
+    QString format() const;
+    void setFormat(const QString& format);
+
+    int quality() const;
+    void setQuality(int quality);
+
+    int compression() const;
+    void setCompression(int compression);
+
+    int threadCount() const;
+    void setThreadCount(int threads);
+
+    bool save(const QImage& image, const QString& path);
+    QString errorString() const;
+
+    static QStringList formats();
+
+private:
+    QString m_format;
+    int m_quality;
+    int m_compression;
+    int m_threadCount;
+    QString m_errorString;
+    QThreadPool m_pool;
+
+    int threads() const;
+    bool saveJpeg(const QImage& image, QFile& file);
+    bool saveTiff(const QImage& image, QFile& file);
+    bool saveWithWriter(const QImage& image, QFile& file, const QString& format);
+};
+
+#endif // IMAGEENCODER_H
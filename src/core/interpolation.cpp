@@ -0,0 +1,860 @@
+/******************************************************************************
+ *
+ * Copyright (c) 2010 Cláudio F. Gil <claudio.f.gil@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+
+#include <QMutex>
+#include <QMutexLocker>
+#include <QAtomicInt>
+#include <QPointF>
+#include <QRgb>
+
+#include <limits.h>
+
+#include "interpolation.h"
+
+/**
+ * Nearest neighbor interpolation.
+ */
+QRgb identityInterpolation(const QRgb* pixels, int width, const QPointF& point)
+{
+    QPoint p = point.toPoint();
+
+    int x = p.x();
+    int y = p.y();
+
+    int pos = y * width + x;
+
+    return pixels[pos];
+}
+
+/**
+ * Nearest neighbor interpolation of a run of count pixels whose 16.16 fixed
+ * point (x, y) coordinates are in points.
+ */
+void identityInterpolationRow(const QRgb* pixels, int width, const qint32* points, QRgb* output, int count)
+{
+    const qint32 half = 1 << 15;
+
+    for (int i = 0; i < count; i++) {
+        int x = (points[0] + half) >> 16;
+        int y = (points[1] + half) >> 16;
+
+        output[i] = pixels[y * width + x];
+        points += 2;
+    }
+}
+
+/**
+ * Bilinear blend of four neighbours, dx and dy being the position between
+ * them in 1/256 of a pixel. Every channel, alpha included, goes through
+ * the same integer arithmetic as the vectorized kernels so all of them
+ * produce the same bits.
+ */
+static inline QRgb bilinearBlend(QRgb rgb00, QRgb rgb10, QRgb rgb01, QRgb rgb11, uint dx, uint dy)
+{
+    // two channels per operation: alpha and green, red and blue
+    uint ag0 = ((rgb00 >> 8) & 0xff00ff) * (256 - dx) + ((rgb10 >> 8) & 0xff00ff) * dx + 0x800080;
+    uint rb0 = ( rgb00       & 0xff00ff) * (256 - dx) + ( rgb10       & 0xff00ff) * dx + 0x800080;
+    uint ag1 = ((rgb01 >> 8) & 0xff00ff) * (256 - dx) + ((rgb11 >> 8) & 0xff00ff) * dx + 0x800080;
+    uint rb1 = ( rgb01       & 0xff00ff) * (256 - dx) + ( rgb11       & 0xff00ff) * dx + 0x800080;
+
+    ag0 = (ag0 >> 8) & 0xff00ff;
+    rb0 = (rb0 >> 8) & 0xff00ff;
+    ag1 = (ag1 >> 8) & 0xff00ff;
+    rb1 = (rb1 >> 8) & 0xff00ff;
+
+    uint ag = ((ag0 * (256 - dy) + ag1 * dy + 0x800080) >> 8) & 0xff00ff;
+    uint rb = ((rb0 * (256 - dy) + rb1 * dy + 0x800080) >> 8) & 0xff00ff;
+
+    return (ag << 8) | rb;
+}
+
+/**
+ * Bilinear interpolation of a single pixel from 16.16 fixed point
+ * coordinates. The base pixel is the one below and left of the point, so
+ * the weights always go towards its right and lower neighbors. Before 16.16
+ * sampling the point was rounded instead, which blended with the wrong side
+ * whenever it rounded up.
+ */
+static inline QRgb bilinearPixel(const QRgb* pixels, int width, qint32 fx, qint32 fy)
+{
+    int x = fx >> 16;
+    int y = fy >> 16;
+
+    const QRgb* p = pixels + y * width + x;
+
+    return bilinearBlend(p[0], p[1], p[width], p[width + 1], (fx >> 8) & 0xff, (fy >> 8) & 0xff);
+}
+
+/**
+ * Bilinear interpolation.
+ */
+QRgb bilinearInterpolation(const QRgb* pixels, int width, const QPointF& point)
+{
+    return bilinearPixel(pixels, width, qRound(point.x() * 65536), qRound(point.y() * 65536));
+}
+
+void bilinearInterpolationRowGeneric(const QRgb* pixels, int width, const qint32* points, QRgb* output, int count)
+{
+    for (int i = 0; i < count; i++) {
+        output[i] = bilinearPixel(pixels, width, points[0], points[1]);
+        points += 2;
+    }
+}
+
+static InterpolationRowFunction selectBilinearRow()
+{
+#if defined(UNWRAP360_X86)
+    if (cpuHasAvx2()) {
+        return bilinearInterpolationRowAvx2;
+    }
+
+    if (cpuHasSse2()) {
+        return bilinearInterpolationRowSse2;
+    }
+#endif
+
+    return bilinearInterpolationRowGeneric;
+}
+
+/**
+ * Bilinear interpolation of a run of count pixels whose 16.16 fixed point
+ * (x, y) coordinates are in points. The best kernel for the running CPU is
+ * chosen on first use.
+ */
+void bilinearInterpolationRow(const QRgb* pixels, int width, const qint32* points, QRgb* output, int count)
+{
+    static const InterpolationRowFunction function = selectBilinearRow();
+    function(pixels, width, points, output, count);
+}
+
+/**
+ * Catmull-Rom weights of the four neighbours of a sample, one set for every
+ * 1/256 of a pixel, scaled by 1 << BicubicWeightBits. Each set is adjusted
+ * to add up exactly to one so flat areas stay flat.
+ */
+class BicubicWeights
+{
+public:
+    BicubicWeights()
+    {
+        const qreal one = 1 << BicubicWeightBits;
+
+        for (int i = 0; i < 256; i++) {
+            qreal t = i / 256.0;
+            qreal t2 = t * t;
+            qreal t3 = t2 * t;
+
+            int* w = m_weights + 4 * i;
+            w[0] = qRound(one * (-t3 + 2 * t2 - t) / 2);
+            w[1] = qRound(one * (3 * t3 - 5 * t2 + 2) / 2);
+            w[2] = qRound(one * (-3 * t3 + 4 * t2 + t) / 2);
+            w[3] = qRound(one * (t3 - t2) / 2);
+
+            int error = (1 << BicubicWeightBits) - (w[0] + w[1] + w[2] + w[3]);
+            w[t < 0.5 ? 1 : 2] += error;
+        }
+    }
+
+    int m_weights[256 * 4];
+};
+
+const int* bicubicWeightTable()
+{
+    static const BicubicWeights weights;
+    return weights.m_weights;
+}
+
+/**
+ * Separable bicubic interpolation of a single pixel from 16.16 fixed point
+ * coordinates. The four rows are first filtered horizontally, keeping four
+ * extra bits, and the results filtered vertically. All channels go through
+ * the same loops, alpha included.
+ */
+static inline QRgb bicubicPixel(const QRgb* pixels, int width, const int* weights, qint32 fx, qint32 fy)
+{
+    // floored like bilinearPixel(), so the fraction is never negative
+    int x = fx >> 16;
+    int y = fy >> 16;
+
+    const int* wx = weights + 4 * ((fx >> 8) & 0xff);
+    const int* wy = weights + 4 * ((fy >> 8) & 0xff);
+
+    const QRgb* p = pixels + (y - 1) * width + (x - 1);
+
+    int sum[4] = { 0, 0, 0, 0 };
+
+    for (int j = 0; j < 4; j++) {
+        int row[4] = { 0, 0, 0, 0 };
+
+        for (int i = 0; i < 4; i++) {
+            QRgb rgb = p[i];
+
+            for (int c = 0; c < 4; c++) {
+                row[c] += int((rgb >> (8 * c)) & 0xff) * wx[i];
+            }
+        }
+
+        for (int c = 0; c < 4; c++) {
+            sum[c] += ((row[c] + (1 << 7)) >> 8) * wy[j];
+        }
+
+        p += width;
+    }
+
+    QRgb rgb = 0;
+
+    for (int c = 0; c < 4; c++) {
+        int value = (sum[c] + (1 << 15)) >> 16;
+        rgb |= uint(qBound(0, value, 255)) << (8 * c);
+    }
+
+    return rgb;
+}
+
+/**
+ * Bicubic interpolation.
+ */
+QRgb bicubicInterpolation(const QRgb* pixels, int width, const QPointF& point)
+{
+    return bicubicPixel(pixels, width, bicubicWeightTable(), qRound(point.x() * 65536), qRound(point.y() * 65536));
+}
+
+void bicubicInterpolationRowGeneric(const QRgb* pixels, int width, const qint32* points, QRgb* output, int count)
+{
+    const int* weights = bicubicWeightTable();
+
+    for (int i = 0; i < count; i++) {
+        output[i] = bicubicPixel(pixels, width, weights, points[0], points[1]);
+        points += 2;
+    }
+}
+
+static InterpolationRowFunction selectBicubicRow()
+{
+#if defined(UNWRAP360_X86)
+    if (cpuHasSse2()) {
+        return bicubicInterpolationRowSse2;
+    }
+#endif
+
+    return bicubicInterpolationRowGeneric;
+}
+
+/**
+ * Bicubic interpolation of a run of count pixels whose 16.16 fixed point
+ * (x, y) coordinates are in points.
+ */
+void bicubicInterpolationRow(const QRgb* pixels, int width, const qint32* points, QRgb* output, int count)
+{
+    static const InterpolationRowFunction function = selectBicubicRow();
+    function(pixels, width, points, output, count);
+}
+
+/*
+ * Kernels for other source layouts. They are instantiated once per layout
+ * so reading a pixel is inlined, and blend with the same arithmetic as the
+ * 32 bit kernels.
+ */
+
+static inline uint reduce16(quint16 value)
+{
+    return (value * 255u + 32895u) >> 16;
+}
+
+struct Rgb32Pixels
+{
+    static inline QRgb fetch(const uchar* line, int x, const QRgb*)
+    {
+        return ((const QRgb*) line)[x];
+    }
+};
+
+struct Rgb888Pixels
+{
+    static inline QRgb fetch(const uchar* line, int x, const QRgb*)
+    {
+        const uchar* p = line + 3 * x;
+        return qRgb(p[0], p[1], p[2]);
+    }
+};
+
+struct Indexed8Pixels
+{
+    static inline QRgb fetch(const uchar* line, int x, const QRgb* colorTable)
+    {
+        return colorTable[line[x]];
+    }
+};
+
+struct Gray8Pixels
+{
+    static inline QRgb fetch(const uchar* line, int x, const QRgb*)
+    {
+        return qRgb(line[x], line[x], line[x]);
+    }
+};
+
+struct Rgb48Pixels
+{
+    static inline QRgb fetch(const uchar* line, int x, const QRgb*)
+    {
+        const quint16* p = (const quint16*) line + 3 * x;
+        return qRgb(reduce16(p[0]), reduce16(p[1]), reduce16(p[2]));
+    }
+};
+
+struct Rgba64Pixels
+{
+    static inline QRgb fetch(const uchar* line, int x, const QRgb*)
+    {
+        const quint16* p = (const quint16*) line + 4 * x;
+        return qRgba(reduce16(p[0]), reduce16(p[1]), reduce16(p[2]), reduce16(p[3]));
+    }
+};
+
+/*
+ * What is done with the coordinates of each pixel. The row loop below is
+ * instantiated for every kernel and layout, so the choice is made once per
+ * row and the kernel is inlined in it.
+ */
+
+struct NearestKernel
+{
+    template <class Pixels>
+    inline QRgb sample(const SourcePixels& source, qint32 fx, qint32 fy) const
+    {
+        const qint32 half = 1 << 15;
+
+        int x = (fx + half) >> 16;
+        int y = (fy + half) >> 16;
+
+        return Pixels::fetch(source.bits + y * source.bytesPerLine, x, source.colorTable);
+    }
+};
+
+struct BilinearKernel
+{
+    template <class Pixels>
+    inline QRgb sample(const SourcePixels& source, qint32 fx, qint32 fy) const
+    {
+        int x = fx >> 16;
+        int y = fy >> 16;
+
+        const uchar* line0 = source.bits + y * source.bytesPerLine;
+        const uchar* line1 = line0 + source.bytesPerLine;
+        const QRgb* colorTable = source.colorTable;
+
+        return bilinearBlend(Pixels::fetch(line0, x, colorTable), Pixels::fetch(line0, x + 1, colorTable),
+                             Pixels::fetch(line1, x, colorTable), Pixels::fetch(line1, x + 1, colorTable),
+                             (fx >> 8) & 0xff, (fy >> 8) & 0xff);
+    }
+};
+
+struct BicubicKernel
+{
+    BicubicKernel() : weights(bicubicWeightTable()) {}
+
+    template <class Pixels>
+    inline QRgb sample(const SourcePixels& source, qint32 fx, qint32 fy) const
+    {
+        int x = fx >> 16;
+        int y = fy >> 16;
+
+        const int* wx = weights + 4 * ((fx >> 8) & 0xff);
+        const int* wy = weights + 4 * ((fy >> 8) & 0xff);
+
+        const uchar* line = source.bits + (y - 1) * source.bytesPerLine;
+        int sum[4] = { 0, 0, 0, 0 };
+
+        for (int j = 0; j < 4; j++) {
+            int row[4] = { 0, 0, 0, 0 };
+
+            for (int i = 0; i < 4; i++) {
+                QRgb rgb = Pixels::fetch(line, x - 1 + i, source.colorTable);
+
+                for (int c = 0; c < 4; c++) {
+                    row[c] += int((rgb >> (8 * c)) & 0xff) * wx[i];
+                }
+            }
+
+            for (int c = 0; c < 4; c++) {
+                sum[c] += ((row[c] + (1 << 7)) >> 8) * wy[j];
+            }
+
+            line += source.bytesPerLine;
+        }
+
+        QRgb rgb = 0;
+
+        for (int c = 0; c < 4; c++) {
+            int value = (sum[c] + (1 << 15)) >> 16;
+            rgb |= uint(qBound(0, value, 255)) << (8 * c);
+        }
+
+        return rgb;
+    }
+
+    const int* weights;
+};
+
+template <class Kernel, class Pixels>
+static void sourceRowT(const SourcePixels& source, const qint32* points, QRgb* output, int count)
+{
+    const Kernel kernel;
+
+    for (int i = 0; i < count; i++) {
+        output[i] = kernel.template sample<Pixels>(source, points[0], points[1]);
+        points += 2;
+    }
+}
+
+/**
+ * Like sourceRowT(), for points near or past the border of the source. The
+ * neighbours of those points are gathered with the coordinates clamped to
+ * the source, and the kernel reads them from there. Other points still go
+ * straight to the source.
+ */
+template <class Kernel, class Pixels>
+static void clampedSourceRowT(const SourcePixels& source, const qint32* points, QRgb* output, int count)
+{
+    const Kernel kernel;
+
+    // the widest kernel reads from one pixel before the point to two after
+    QRgb block[4 * 4];
+    SourcePixels local;
+    local.bits = (const uchar*) block;
+    local.width = 4;
+    local.height = 4;
+    local.bytesPerLine = 4 * sizeof(QRgb);
+
+    for (int n = 0; n < count; n++) {
+        qint32 fx = points[0];
+        qint32 fy = points[1];
+        int x = fx >> 16;
+        int y = fy >> 16;
+
+        if (x >= 1 && y >= 1 && x + 2 < source.width && y + 2 < source.height) {
+            output[n] = kernel.template sample<Pixels>(source, fx, fy);
+        }
+        else {
+            for (int j = 0; j < 4; j++) {
+                int sy = qBound(0, y - 1 + j, source.height - 1);
+                const uchar* line = source.bits + sy * source.bytesPerLine;
+
+                for (int i = 0; i < 4; i++) {
+                    int sx = qBound(0, x - 1 + i, source.width - 1);
+                    block[4 * j + i] = Pixels::fetch(line, sx, source.colorTable);
+                }
+            }
+
+            // the point keeps its fraction, one pixel into the block
+            output[n] = kernel.template sample<Rgb32Pixels>(local, (fx & 0xffff) + (1 << 16), (fy & 0xffff) + (1 << 16));
+        }
+
+        points += 2;
+    }
+}
+
+template <class Kernel>
+static SourceRowFunction clampedRowFor(SourceFormat format)
+{
+    switch (format) {
+    case SourceRgb32:
+        return clampedSourceRowT<Kernel, Rgb32Pixels>;
+    case SourceRgb888:
+        return clampedSourceRowT<Kernel, Rgb888Pixels>;
+    case SourceIndexed8:
+        return clampedSourceRowT<Kernel, Indexed8Pixels>;
+    case SourceGray8:
+        return clampedSourceRowT<Kernel, Gray8Pixels>;
+    case SourceRgb48:
+        return clampedSourceRowT<Kernel, Rgb48Pixels>;
+    case SourceRgba64:
+        return clampedSourceRowT<Kernel, Rgba64Pixels>;
+    }
+
+    return 0;
+}
+
+/**
+ * Row kernel of Kernel for the layouts without a vectorized one.
+ */
+template <class Kernel>
+static SourceRowFunction sourceRowFor(SourceFormat format)
+{
+    switch (format) {
+    case SourceRgb32:
+        break;
+    case SourceRgb888:
+        return sourceRowT<Kernel, Rgb888Pixels>;
+    case SourceIndexed8:
+        return sourceRowT<Kernel, Indexed8Pixels>;
+    case SourceGray8:
+        return sourceRowT<Kernel, Gray8Pixels>;
+    case SourceRgb48:
+        return sourceRowT<Kernel, Rgb48Pixels>;
+    case SourceRgba64:
+        return sourceRowT<Kernel, Rgba64Pixels>;
+    }
+
+    return 0;
+}
+
+/*
+ * 32 bit sources keep going through the vectorized kernels.
+ */
+static void identityRgb32Row(const SourcePixels& source, const qint32* points, QRgb* output, int count)
+{
+    identityInterpolationRow((const QRgb*) source.bits, source.bytesPerLine / sizeof(QRgb), points, output, count);
+}
+
+static void bilinearRgb32Row(const SourcePixels& source, const qint32* points, QRgb* output, int count)
+{
+    bilinearInterpolationRow((const QRgb*) source.bits, source.bytesPerLine / sizeof(QRgb), points, output, count);
+}
+
+static void bicubicRgb32Row(const SourcePixels& source, const qint32* points, QRgb* output, int count)
+{
+    bicubicInterpolationRow((const QRgb*) source.bits, source.bytesPerLine / sizeof(QRgb), points, output, count);
+}
+
+/**
+ * Nearest neighbor row kernel for sources in format.
+ */
+SourceRowFunction identitySourceRow(SourceFormat format)
+{
+    return format == SourceRgb32 ? identityRgb32Row : sourceRowFor<NearestKernel>(format);
+}
+
+/**
+ * Bilinear row kernel for sources in format.
+ */
+SourceRowFunction bilinearSourceRow(SourceFormat format)
+{
+    return format == SourceRgb32 ? bilinearRgb32Row : sourceRowFor<BilinearKernel>(format);
+}
+
+/**
+ * Bicubic row kernel for sources in format.
+ */
+SourceRowFunction bicubicSourceRow(SourceFormat format)
+{
+    return format == SourceRgb32 ? bicubicRgb32Row : sourceRowFor<BicubicKernel>(format);
+}
+
+/**
+ * Nearest neighbor row kernel that keeps to the source.
+ */
+SourceRowFunction clampedIdentitySourceRow(SourceFormat format)
+{
+    return clampedRowFor<NearestKernel>(format);
+}
+
+/**
+ * Bilinear row kernel that keeps to the source.
+ */
+SourceRowFunction clampedBilinearSourceRow(SourceFormat format)
+{
+    return clampedRowFor<BilinearKernel>(format);
+}
+
+/**
+ * Bicubic row kernel that keeps to the source.
+ */
+SourceRowFunction clampedBicubicSourceRow(SourceFormat format)
+{
+    return clampedRowFor<BicubicKernel>(format);
+}
+
+/**
+ * Number of bilinear samples along a step of the map, one per source pixel
+ * it spans.
+ */
+static inline int areaTaps(qint32 dx, qint32 dy)
+{
+    qint32 length = qMax(qAbs(dx), qAbs(dy));
+    return qBound(1, (length + 0xffff) >> 16, int(AreaMaxTaps));
+}
+
+/**
+ * Averages count pixels of taps samples each from samples into output.
+ */
+static void averageTaps(const QRgb* samples, const int* taps, QRgb* output, int count)
+{
+    for (int i = 0; i < count; i++) {
+        int n = taps[i];
+        uint sum[4] = { 0, 0, 0, 0 };
+
+        for (int k = 0; k < n; k++) {
+            QRgb rgb = *samples++;
+
+            for (int c = 0; c < 4; c++) {
+                sum[c] += (rgb >> (8 * c)) & 0xff;
+            }
+        }
+
+        QRgb rgb = 0;
+
+        for (int c = 0; c < 4; c++) {
+            rgb |= ((sum[c] + n / 2) / n) << (8 * c);
+        }
+
+        output[i] = rgb;
+    }
+}
+
+/**
+ * Whether bilinear samples of points within the given 16.16 fixed point
+ * bounds read only pixels of the source.
+ */
+static inline bool insideSource(const SourcePixels& source, qint32 left, qint32 top, qint32 right, qint32 bottom)
+{
+    return (left >> 16) >= 0 && (top >> 16) >= 0
+            && (right >> 16) + 1 < source.width && (bottom >> 16) + 1 < source.height;
+}
+
+/**
+ * Area averaging of a run of count pixels. Each pixel covers the
+ * parallelogram spanned by the step to its right neighbour in points and
+ * the step to the same pixel in nextPoints, an adjacent row of the map. It
+ * is the mean of a grid of bilinear samples spread over that footprint,
+ * one per source pixel covered and at most AreaMaxTaps along each side.
+ * Where the map enlarges the source this is plain bilinear interpolation.
+ *
+ * Samples of several pixels are gathered and handed to the bilinear row
+ * kernel of the format at once, so 32 bit sources stay vectorized. Chunks
+ * whose footprints come near the border of the source go to the clamped
+ * kernel instead.
+ */
+void areaSourceRow(const SourcePixels& source, const qint32* points, const qint32* nextPoints, QRgb* output, int count)
+{
+    enum { ChunkTaps = 1024 };
+
+    SourceRowFunction fast = bilinearSourceRow(source.format);
+    SourceRowFunction clamped = clampedBilinearSourceRow(source.format);
+    SourceRowFunction sample = fast;
+
+    // bounds of the footprints in the chunk, in 16.16 fixed point
+    qint32 left = INT_MAX;
+    qint32 top = INT_MAX;
+    qint32 right = INT_MIN;
+    qint32 bottom = INT_MIN;
+
+    qint32 chunkPoints[2 * ChunkTaps];
+    QRgb chunkSamples[ChunkTaps];
+    int taps[ChunkTaps];
+
+    int first = 0;
+    int used = 0;
+
+    for (int i = 0; i < count; i++) {
+        const qint32* p = points + 2 * i;
+
+        // the last pixel has no right neighbour, its left one is as far
+        qint32 ux = 0;
+        qint32 uy = 0;
+        if (i + 1 < count) {
+            ux = p[2] - p[0];
+            uy = p[3] - p[1];
+        }
+        else if (i > 0) {
+            ux = p[0] - p[-2];
+            uy = p[1] - p[-1];
+        }
+
+        qint32 vx = nextPoints[2 * i] - p[0];
+        qint32 vy = nextPoints[2 * i + 1] - p[1];
+
+        int nu = areaTaps(ux, uy);
+        int nv = areaTaps(vx, vy);
+
+        if (used + nu * nv > ChunkTaps) {
+            sample = insideSource(source, left, top, right, bottom) ? fast : clamped;
+            sample(source, chunkPoints, chunkSamples, used);
+            averageTaps(chunkSamples, taps, output + first, i - first);
+
+            first = i;
+            used = 0;
+            left = top = INT_MAX;
+            right = bottom = INT_MIN;
+        }
+
+        // the taps stay within half of both steps around the point
+        qint32 ex = (qAbs(ux) + qAbs(vx)) / 2;
+        qint32 ey = (qAbs(uy) + qAbs(vy)) / 2;
+        left = qMin(left, p[0] - ex);
+        right = qMax(right, p[0] + ex);
+        top = qMin(top, p[1] - ey);
+        bottom = qMax(bottom, p[1] + ey);
+
+        qint32* tap = chunkPoints + 2 * used;
+
+        for (int v = 0; v < nv; v++) {
+            // samples sit at the centers of an nu by nv grid over the footprint
+            qint64 sv = 2 * v + 1 - nv;
+            qint32 ox = p[0] + qint32(vx * sv / (2 * nv));
+            qint32 oy = p[1] + qint32(vy * sv / (2 * nv));
+
+            for (int u = 0; u < nu; u++) {
+                qint64 su = 2 * u + 1 - nu;
+                *tap++ = ox + qint32(ux * su / (2 * nu));
+                *tap++ = oy + qint32(uy * su / (2 * nu));
+            }
+        }
+
+        taps[i - first] = nu * nv;
+        used += nu * nv;
+    }
+
+    sample = insideSource(source, left, top, right, bottom) ? fast : clamped;
+    sample(source, chunkPoints, chunkSamples, used);
+    averageTaps(chunkSamples, taps, output + first, count - first);
+}
+
+static const Sampler builtinSamplers[] = {
+    { 0, "nearest", QT_TRANSLATE_NOOP("Sampler", "Nearest Neighbor"), 1,
+      identitySourceRow, clampedIdentitySourceRow, 0 },
+    { 1, "bilinear", QT_TRANSLATE_NOOP("Sampler", "Bilinear"), 1,
+      bilinearSourceRow, clampedBilinearSourceRow, 0 },
+    { 2, "bicubic", QT_TRANSLATE_NOOP("Sampler", "Bicubic"), 2,
+      bicubicSourceRow, clampedBicubicSourceRow, 0 },
+    { 3, "area", QT_TRANSLATE_NOOP("Sampler", "Area Average"), 0,
+      0, 0, areaSourceRow }
+};
+
+static QMutex samplersMutex;
+static QList<const Sampler*> registeredSamplers;
+
+// lets findSampler() skip the lock until something is registered
+static QAtomicInt registeredCount(0);
+
+SamplerKernels::SamplerKernels() :
+    pointRow(0), clampedRow(0), footprintRow(0), reach(0)
+{
+}
+
+/**
+ * Kernels of sampler for format. Samplers without a clamped kernel use
+ * their point one everywhere. A null sampler has no kernels.
+ */
+SamplerKernels::SamplerKernels(const Sampler* sampler, SourceFormat format) :
+    pointRow(0), clampedRow(0), footprintRow(0), reach(0)
+{
+    if (!sampler) {
+        return;
+    }
+
+    pointRow = sampler->pointRow ? sampler->pointRow(format) : 0;
+    clampedRow = sampler->clampedRow ? sampler->clampedRow(format) : pointRow;
+    footprintRow = sampler->footprintRow;
+    reach = sampler->reach;
+}
+
+/**
+ * Adds a sampler, or replaces the one of the same interpolation. It is not
+ * owned and must outlive every unwrap, so it is usually a static.
+ * Interpolations from Unwrapper::UserInterpolation on are free for new
+ * samplers.
+ */
+void registerSampler(const Sampler* sampler)
+{
+    QMutexLocker locker(&samplersMutex);
+
+    for (int i = 0; i < registeredSamplers.size(); i++) {
+        if (registeredSamplers.at(i)->interpolation == sampler->interpolation) {
+            registeredSamplers[i] = sampler;
+            return;
+        }
+    }
+
+    registeredSamplers.append(sampler);
+    registeredCount.fetchAndStoreOrdered(registeredSamplers.size());
+}
+
+/**
+ * Sampler of an interpolation, or 0 if there is none.
+ */
+const Sampler* findSampler(int interpolation)
+{
+    if (registeredCount != 0) {
+        QMutexLocker locker(&samplersMutex);
+
+        foreach (const Sampler* registered, registeredSamplers) {
+            if (registered->interpolation == interpolation) {
+                return registered;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < sizeof(builtinSamplers) / sizeof(builtinSamplers[0]); i++) {
+        if (builtinSamplers[i].interpolation == interpolation) {
+            return &builtinSamplers[i];
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Sampler of the given name, ignoring case, or 0 if there is none.
+ */
+const Sampler* findSampler(const QString& name)
+{
+    foreach (const Sampler* sampler, samplers()) {
+        if (name.compare(QLatin1String(sampler->name), Qt::CaseInsensitive) == 0) {
+            return sampler;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * The built in samplers, in the order of their interpolations, then the
+ * registered ones. Registered samplers take the place of built in ones.
+ */
+QList<const Sampler*> samplers()
+{
+    QMutexLocker locker(&samplersMutex);
+    QList<const Sampler*> list;
+
+    for (size_t i = 0; i < sizeof(builtinSamplers) / sizeof(builtinSamplers[0]); i++) {
+        list.append(&builtinSamplers[i]);
+    }
+
+    foreach (const Sampler* registered, registeredSamplers) {
+        int i = 0;
+        while (i < list.size() && list.at(i)->interpolation != registered->interpolation) {
+            i++;
+        }
+
+        if (i < list.size()) {
+            list[i] = registered;
+        }
+        else {
+            list.append(registered);
+        }
+    }
+
+    return list;
+}
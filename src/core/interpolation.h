@@ -0,0 +1,156 @@
+/******************************************************************************
+ *
+ * Copyright (c) 2010 Cláudio F. Gil <claudio.f.gil@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+
+#ifndef INTERPOLATION_H
+#define INTERPOLATION_H
+
+#include <QList>
+#include <QPointF>
+#include <QRgb>
+#include <QString>
+
+QRgb identityInterpolation(const QRgb* pixels, int width, const QPointF& point);
+QRgb bilinearInterpolation(const QRgb* pixels, int width, const QPointF& point);
+QRgb bicubicInterpolation(const QRgb* pixels, int width, const QPointF& point);
+
+typedef void (*InterpolationRowFunction)(const QRgb* pixels, int width, const qint32* points, QRgb* output, int count);
+
+void identityInterpolationRow(const QRgb* pixels, int width, const qint32* points, QRgb* output, int count);
+
+void bilinearInterpolationRow(const QRgb* pixels, int width, const qint32* points, QRgb* output, int count);
+void bilinearInterpolationRowGeneric(const QRgb* pixels, int width, const qint32* points, QRgb* output, int count);
+
+enum {
+    BicubicWeightBits = 12
+};
+
+const int* bicubicWeightTable();
+
+void bicubicInterpolationRow(const QRgb* pixels, int width, const qint32* points, QRgb* output, int count);
+void bicubicInterpolationRowGeneric(const QRgb* pixels, int width, const qint32* points, QRgb* output, int count);
+
+/**
+ * Pixel layouts the row kernels read without converting the source first.
+ * 16 bit channels are in native byte order and are reduced to 8 bits as
+ * they are read.
+ */
+enum SourceFormat {
+    SourceRgb32,        // QRgb, as QImage::Format_RGB32 and ARGB32
+    SourceRgb888,       // red, green, blue bytes
+    SourceIndexed8,     // byte index into a color table of 256 entries
+    SourceGray8,
+    SourceRgb48,        // red, green, blue 16 bit words
+    SourceRgba64        // red, green, blue, alpha 16 bit words
+};
+
+/**
+ * Source image as seen by the row kernels. The size is only read by the
+ * clamped kernels, the others trust every point to be well inside.
+ */
+struct SourcePixels
+{
+    SourcePixels() : bits(0), width(0), height(0), bytesPerLine(0), format(SourceRgb32), colorTable(0), alpha(false) {}
+
+    const uchar* bits;
+    int width;
+    int height;
+    int bytesPerLine;
+    SourceFormat format;
+    const QRgb* colorTable;
+    /** Whether the pixels carry alpha; opaque sources unwrap to RGB32. */
+    bool alpha;
+};
+
+typedef void (*SourceRowFunction)(const SourcePixels& source, const qint32* points, QRgb* output, int count);
+
+SourceRowFunction identitySourceRow(SourceFormat format);
+SourceRowFunction bilinearSourceRow(SourceFormat format);
+SourceRowFunction bicubicSourceRow(SourceFormat format);
+
+SourceRowFunction clampedIdentitySourceRow(SourceFormat format);
+SourceRowFunction clampedBilinearSourceRow(SourceFormat format);
+SourceRowFunction clampedBicubicSourceRow(SourceFormat format);
+
+enum {
+    AreaMaxTaps = 8
+};
+
+void areaSourceRow(const SourcePixels& source, const qint32* points, const qint32* nextPoints, QRgb* output, int count);
+
+typedef void (*FootprintRowFunction)(const SourcePixels& source, const qint32* points, const qint32* nextPoints,
+                                     QRgb* output, int count);
+
+/**
+ * A way of sampling the source, found by the interpolation it implements.
+ *
+ * Samplers reading a point per pixel give their row kernel for each source
+ * layout, and a clamped one that repeats the edge pixels of the source.
+ * The clamped kernel is used for the tiles of the map that come closer to
+ * the border than the pixels the kernel reaches around each point.
+ *
+ * Those averaging the footprint of each pixel also get the points of an
+ * adjacent row instead, like areaSourceRow(), sample at the final size and
+ * keep to the source on their own.
+ */
+struct Sampler
+{
+    int interpolation;
+    const char* name;
+    const char* label;      // shown to users, translated in the "Sampler" context
+    int reach;
+    SourceRowFunction (*pointRow)(SourceFormat format);
+    SourceRowFunction (*clampedRow)(SourceFormat format);
+    FootprintRowFunction footprintRow;
+};
+
+/**
+ * The kernels of a sampler for one source layout, looked up once before
+ * an unwrap instead of for each band.
+ */
+struct SamplerKernels
+{
+    SamplerKernels();
+    SamplerKernels(const Sampler* sampler, SourceFormat format);
+
+    SourceRowFunction pointRow;
+    SourceRowFunction clampedRow;
+    FootprintRowFunction footprintRow;
+    int reach;
+};
+
+void registerSampler(const Sampler* sampler);
+const Sampler* findSampler(int interpolation);
+const Sampler* findSampler(const QString& name);
+QList<const Sampler*> samplers();
+
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#define UNWRAP360_X86
+
+bool cpuHasSse2();
+bool cpuHasAvx2();
+void bilinearInterpolationRowSse2(const QRgb* pixels, int width, const qint32* points, QRgb* output, int count);
+void bilinearInterpolationRowAvx2(const QRgb* pixels, int width, const qint32* points, QRgb* output, int count);
+void bicubicInterpolationRowSse2(const QRgb* pixels, int width, const qint32* points, QRgb* output, int count);
+#endif
+
+#endif // INTERPOLATION_H
@@ -0,0 +1,242 @@
+/******************************************************************************
+ *
+ * Copyright (c) 2010 Cláudio F. Gil <claudio.f.gil@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+
+#include "interpolation.h"
+
+#if defined(UNWRAP360_X86)
+
+#include <immintrin.h>
+
+/*
+ * Vectorized bilinear kernels. Each output pixel is computed on a 128 bit
+ * lane holding its four source pixels widened to 16 bits per channel:
+ *
+ *   [ p00 p01 | p10 p11 ]  ->  horizontal pass  ->  [ top | bottom ]
+ *
+ * followed by a vertical pass that folds the bottom half onto the top one.
+ * The arithmetic is the same as bilinearPixel() in interpolation.cpp, so the
+ * results are bit-identical to the generic kernel.
+ */
+
+bool cpuHasSse2()
+{
+    return __builtin_cpu_supports("sse2");
+}
+
+bool cpuHasAvx2()
+{
+    return __builtin_cpu_supports("avx2");
+}
+
+__attribute__((target("sse2")))
+static inline __m128i bilinearLaneSse2(const QRgb* pixels, int width, const qint32* point)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i half = _mm_set1_epi16(128);
+
+    int x = point[0] >> 16;
+    int y = point[1] >> 16;
+
+    short dx = (point[0] >> 8) & 0xff;
+    short dy = (point[1] >> 8) & 0xff;
+
+    const QRgb* p = pixels + y * width + x;
+
+    __m128i top = _mm_loadl_epi64((const __m128i*) p);
+    __m128i bottom = _mm_loadl_epi64((const __m128i*) (p + width));
+    __m128i quad = _mm_unpacklo_epi32(top, bottom);
+
+    __m128i left = _mm_unpacklo_epi8(quad, zero);
+    __m128i right = _mm_unpackhi_epi8(quad, zero);
+
+    __m128i h = _mm_add_epi16(_mm_mullo_epi16(left, _mm_set1_epi16(256 - dx)),
+                              _mm_mullo_epi16(right, _mm_set1_epi16(dx)));
+    h = _mm_srli_epi16(_mm_add_epi16(h, half), 8);
+
+    __m128i v = _mm_mullo_epi16(h, _mm_set_epi16(dy, dy, dy, dy, 256 - dy, 256 - dy, 256 - dy, 256 - dy));
+    v = _mm_add_epi16(v, _mm_srli_si128(v, 8));
+
+    return _mm_srli_epi16(_mm_add_epi16(v, half), 8);
+}
+
+__attribute__((target("sse2")))
+void bilinearInterpolationRowSse2(const QRgb* pixels, int width, const qint32* points, QRgb* output, int count)
+{
+    int i = 0;
+
+    for (; i + 2 <= count; i += 2) {
+        __m128i a = bilinearLaneSse2(pixels, width, points);
+        __m128i b = bilinearLaneSse2(pixels, width, points + 2);
+
+        __m128i ab = _mm_packus_epi16(_mm_unpacklo_epi64(a, b), a);
+        _mm_storel_epi64((__m128i*) (output + i), ab);
+
+        points += 4;
+    }
+
+    if (i < count) {
+        bilinearInterpolationRowGeneric(pixels, width, points, output + i, count - i);
+    }
+}
+
+__attribute__((target("avx2")))
+static inline __m256i bilinearLanesAvx2(const QRgb* pixels, int width, const qint32* first, const qint32* second)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i half = _mm256_set1_epi16(128);
+
+    const QRgb* p0 = pixels + (first[1] >> 16) * width + (first[0] >> 16);
+    const QRgb* p1 = pixels + (second[1] >> 16) * width + (second[0] >> 16);
+
+    short dx0 = (first[0] >> 8) & 0xff;
+    short dy0 = (first[1] >> 8) & 0xff;
+    short dx1 = (second[0] >> 8) & 0xff;
+    short dy1 = (second[1] >> 8) & 0xff;
+
+    __m128i quad0 = _mm_unpacklo_epi32(_mm_loadl_epi64((const __m128i*) p0),
+                                       _mm_loadl_epi64((const __m128i*) (p0 + width)));
+    __m128i quad1 = _mm_unpacklo_epi32(_mm_loadl_epi64((const __m128i*) p1),
+                                       _mm_loadl_epi64((const __m128i*) (p1 + width)));
+    __m256i quad = _mm256_inserti128_si256(_mm256_castsi128_si256(quad0), quad1, 1);
+
+    __m256i left = _mm256_unpacklo_epi8(quad, zero);
+    __m256i right = _mm256_unpackhi_epi8(quad, zero);
+
+    __m256i wx = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_set1_epi16(dx0)), _mm_set1_epi16(dx1), 1);
+    __m256i wy = _mm256_inserti128_si256(
+                _mm256_castsi128_si256(_mm_set_epi16(dy0, dy0, dy0, dy0, 256 - dy0, 256 - dy0, 256 - dy0, 256 - dy0)),
+                _mm_set_epi16(dy1, dy1, dy1, dy1, 256 - dy1, 256 - dy1, 256 - dy1, 256 - dy1), 1);
+
+    __m256i h = _mm256_add_epi16(_mm256_mullo_epi16(left, _mm256_sub_epi16(_mm256_set1_epi16(256), wx)),
+                                 _mm256_mullo_epi16(right, wx));
+    h = _mm256_srli_epi16(_mm256_add_epi16(h, half), 8);
+
+    __m256i v = _mm256_mullo_epi16(h, wy);
+    v = _mm256_add_epi16(v, _mm256_srli_si256(v, 8));
+
+    return _mm256_srli_epi16(_mm256_add_epi16(v, half), 8);
+}
+
+__attribute__((target("avx2")))
+void bilinearInterpolationRowAvx2(const QRgb* pixels, int width, const qint32* points, QRgb* output, int count)
+{
+    int i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        // ac holds pixels 0 and 2, one per lane, and bd pixels 1 and 3
+        __m256i ac = bilinearLanesAvx2(pixels, width, points, points + 4);
+        __m256i bd = bilinearLanesAvx2(pixels, width, points + 2, points + 6);
+
+        __m256i packed = _mm256_packus_epi16(_mm256_unpacklo_epi64(ac, bd), ac);
+        packed = _mm256_permute4x64_epi64(packed, 0x08);
+        _mm_storeu_si128((__m128i*) (output + i), _mm256_castsi256_si128(packed));
+
+        points += 8;
+    }
+
+    if (i < count) {
+        bilinearInterpolationRowSse2(pixels, width, points, output + i, count - i);
+    }
+}
+
+/*
+ * Vectorized bicubic kernel. Pairs of neighbours are interleaved channel by
+ * channel so a single multiply-add applies two weights to all four channels:
+ *
+ *   [ p0.b p1.b p0.g p1.g p0.r p1.r p0.a p1.a ] x [ w0 w1 w0 w1 ... ]
+ *
+ * The rows are filtered like that horizontally and then, two rows at a time,
+ * vertically, with the same rounding as bicubicPixel() in interpolation.cpp.
+ */
+
+__attribute__((target("sse2")))
+static inline __m128i bicubicRowSse2(const QRgb* p, __m128i w01, __m128i w23)
+{
+    const __m128i zero = _mm_setzero_si128();
+
+    __m128i row = _mm_loadu_si128((const __m128i*) p);
+
+    __m128i p01 = _mm_unpacklo_epi8(row, zero);
+    __m128i p23 = _mm_unpackhi_epi8(row, zero);
+
+    p01 = _mm_unpacklo_epi16(p01, _mm_srli_si128(p01, 8));
+    p23 = _mm_unpacklo_epi16(p23, _mm_srli_si128(p23, 8));
+
+    __m128i sum = _mm_add_epi32(_mm_madd_epi16(p01, w01), _mm_madd_epi16(p23, w23));
+
+    return _mm_srai_epi32(_mm_add_epi32(sum, _mm_set1_epi32(1 << 7)), 8);
+}
+
+__attribute__((target("sse2")))
+static inline __m128i weightPair(int first, int second)
+{
+    return _mm_set_epi16(second, first, second, first, second, first, second, first);
+}
+
+__attribute__((target("sse2")))
+static inline QRgb bicubicPixelSse2(const QRgb* pixels, int width, const int* weights, const qint32* point)
+{
+    int x = point[0] >> 16;
+    int y = point[1] >> 16;
+
+    const int* wx = weights + 4 * ((point[0] >> 8) & 0xff);
+    const int* wy = weights + 4 * ((point[1] >> 8) & 0xff);
+
+    __m128i wx01 = weightPair(wx[0], wx[1]);
+    __m128i wx23 = weightPair(wx[2], wx[3]);
+
+    const QRgb* p = pixels + (y - 1) * width + (x - 1);
+
+    __m128i r0 = bicubicRowSse2(p, wx01, wx23);
+    __m128i r1 = bicubicRowSse2(p + width, wx01, wx23);
+    __m128i r2 = bicubicRowSse2(p + 2 * width, wx01, wx23);
+    __m128i r3 = bicubicRowSse2(p + 3 * width, wx01, wx23);
+
+    __m128i r01 = _mm_packs_epi32(r0, r1);
+    __m128i r23 = _mm_packs_epi32(r2, r3);
+
+    r01 = _mm_unpacklo_epi16(r01, _mm_srli_si128(r01, 8));
+    r23 = _mm_unpacklo_epi16(r23, _mm_srli_si128(r23, 8));
+
+    __m128i sum = _mm_add_epi32(_mm_madd_epi16(r01, weightPair(wy[0], wy[1])),
+                                _mm_madd_epi16(r23, weightPair(wy[2], wy[3])));
+    sum = _mm_srai_epi32(_mm_add_epi32(sum, _mm_set1_epi32(1 << 15)), 16);
+
+    sum = _mm_packs_epi32(sum, sum);
+    sum = _mm_packus_epi16(sum, sum);
+
+    return _mm_cvtsi128_si32(sum);
+}
+
+__attribute__((target("sse2")))
+void bicubicInterpolationRowSse2(const QRgb* pixels, int width, const qint32* points, QRgb* output, int count)
+{
+    const int* weights = bicubicWeightTable();
+
+    for (int i = 0; i < count; i++) {
+        output[i] = bicubicPixelSse2(pixels, width, weights, points);
+        points += 2;
+    }
+}
+
+#endif // UNWRAP360_X86
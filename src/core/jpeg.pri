@@ -0,0 +1,9 @@
+#
+# Streaming and parallel JPEG output through libjpeg. Disable with
+# CONFIG+=nojpeg.
+#
+
+unix:!nojpeg {
+    DEFINES += UNWRAP360_JPEG
+    LIBS += -ljpeg
+}
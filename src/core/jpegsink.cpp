@@ -0,0 +1,187 @@
+/******************************************************************************
+ *
+ * Copyright (c) 2010 Cláudio F. Gil <claudio.f.gil@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+#include "jpegsink.h"
+
+#ifdef UNWRAP360_JPEG
+
+#include <QFile>
+
+#include <stdio.h>
+#include <setjmp.h>
+
+extern "C" {
+#include <jpeglib.h>
+}
+
+/**
+ * libjpeg exits the process on errors unless error_exit jumps back out.
+ */
+struct JpegError
+{
+    jpeg_error_mgr manager;
+    jmp_buf jump;
+    char message[JMSG_LENGTH_MAX];
+};
+
+struct JpegSinkPrivate
+{
+    jpeg_compress_struct info;
+    JpegError error;
+    FILE* file;
+    bool started;
+    QByteArray line;
+};
+
+extern "C" {
+static void jpegErrorExit(j_common_ptr info)
+{
+    JpegError* error = (JpegError*) info->err;
+    (*info->err->format_message)(info, error->message);
+    longjmp(error->jump, 1);
+}
+}
+
+JpegSink::JpegSink(const QString& path, int quality) :
+    m_path(path),
+    m_quality(qBound(0, quality, 100)),
+    d(new JpegSinkPrivate())
+{
+    d->file = 0;
+    d->started = false;
+
+    d->info.err = jpeg_std_error(&d->error.manager);
+    d->error.manager.error_exit = jpegErrorExit;
+    jpeg_create_compress(&d->info);
+}
+
+JpegSink::~JpegSink()
+{
+    abort();
+    jpeg_destroy_compress(&d->info);
+    delete d;
+}
+
+/**
+ * Drops an unfinished image, leaving no partial file behind.
+ */
+void JpegSink::abort()
+{
+    if (d->started) {
+        jpeg_abort_compress(&d->info);
+        d->started = false;
+    }
+
+    if (d->file) {
+        fclose(d->file);
+        d->file = 0;
+        QFile::remove(m_path);
+    }
+}
+
+bool JpegSink::begin(const QSize& size, QImage::Format format)
+{
+    if (format != QImage::Format_RGB32 && format != QImage::Format_ARGB32
+            && format != QImage::Format_ARGB32_Premultiplied) {
+        setErrorString("only 32 bit images can be written");
+        return false;
+    }
+
+    d->file = fopen(QFile::encodeName(m_path).constData(), "wb");
+    if (!d->file) {
+        setErrorString(QString("cannot open %1").arg(m_path));
+        return false;
+    }
+
+    if (setjmp(d->error.jump)) {
+        setErrorString(d->error.message);
+        abort();
+        return false;
+    }
+
+    jpeg_stdio_dest(&d->info, d->file);
+
+    d->info.image_width = size.width();
+    d->info.image_height = size.height();
+    d->info.input_components = 3;
+    d->info.in_color_space = JCS_RGB;
+
+    jpeg_set_defaults(&d->info);
+    jpeg_set_quality(&d->info, m_quality, TRUE);
+    jpeg_start_compress(&d->info, TRUE);
+    d->started = true;
+
+    d->line.resize(3 * size.width());
+
+    return true;
+}
+
+bool JpegSink::write(const QImage& band, int rows)
+{
+    if (setjmp(d->error.jump)) {
+        setErrorString(d->error.message);
+        abort();
+        return false;
+    }
+
+    int width = d->info.image_width;
+
+    for (int y = 0; y < rows; y++) {
+        const QRgb* pixels = (const QRgb*) band.scanLine(y);
+        JSAMPLE* line = (JSAMPLE*) d->line.data();
+
+        for (int x = 0; x < width; x++) {
+            *line++ = qRed(pixels[x]);
+            *line++ = qGreen(pixels[x]);
+            *line++ = qBlue(pixels[x]);
+        }
+
+        JSAMPROW row = (JSAMPROW) d->line.data();
+        jpeg_write_scanlines(&d->info, &row, 1);
+    }
+
+    return true;
+}
+
+bool JpegSink::finish()
+{
+    if (setjmp(d->error.jump)) {
+        setErrorString(d->error.message);
+        abort();
+        return false;
+    }
+
+    jpeg_finish_compress(&d->info);
+    d->started = false;
+
+    bool ok = fclose(d->file) == 0;
+    d->file = 0;
+
+    if (!ok) {
+        setErrorString(QString("cannot write %1").arg(m_path));
+        QFile::remove(m_path);
+    }
+
+    return ok;
+}
+
+#endif // UNWRAP360_JPEG
@@ -0,0 +1,59 @@
+/******************************************************************************
+ *
+ * Copyright (c) 2010 Cláudio F. Gil <claudio.f.gil@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+#ifndef JPEGSINK_H
+#define JPEGSINK_H
+
+#ifdef UNWRAP360_JPEG
+
+#include <QByteArray>
+#include <QString>
+
+#include "unwrapsink.h"
+
+struct JpegSinkPrivate;
+
+/**
+ * Writes JPEG through libjpeg one scanline at a time, so only a band of the
+ * image is ever in memory.
+ */
+class JpegSink : public UnwrapSink
+{
+public:
+    JpegSink(const QString& path, int quality);
+    ~JpegSink();
+
+    bool begin(const QSize& size, QImage::Format format);
+    bool write(const QImage& band, int rows);
+    bool finish();
+
+private:
+    QString m_path;
+    int m_quality;
+    JpegSinkPrivate* d;
+
+    void abort();
+};
+
+#endif // UNWRAP360_JPEG
+
+#endif // JPEGSINK_H
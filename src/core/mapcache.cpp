@@ -0,0 +1,297 @@
+/******************************************************************************
+ *
+ * Copyright (c) 2010 Cláudio F. Gil <claudio.f.gil@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMap>
+#include <QMutexLocker>
+#include <QTextStream>
+
+#if QT_VERSION >= 0x050000
+#include <QStandardPaths>
+#else
+#include <QDesktopServices>
+#endif
+
+#include "mapcache.h"
+#include "unwrapper.h"
+
+static const char* IndexFileName = "index";
+
+MapCache::MapCache(const QString& directory) :
+    m_directory(directory),
+    m_maxSize(qint64(DefaultMaxSize) * 1024 * 1024)
+{
+}
+
+/**
+ * The maps directory in the cache location of the user.
+ */
+QString MapCache::defaultDirectory()
+{
+#if QT_VERSION >= 0x050000
+    QString cache = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+#else
+    QString cache = QDesktopServices::storageLocation(QDesktopServices::CacheLocation);
+#endif
+
+    return cache.isEmpty() ? QString() : cache + "/maps";
+}
+
+QString MapCache::directory() const
+{
+    return m_directory;
+}
+
+qint64 MapCache::maxSize() const
+{
+    return m_maxSize;
+}
+
+void MapCache::setMaxSize(qint64 bytes)
+{
+    m_maxSize = bytes;
+}
+
+/**
+ * The map of parameters, loaded from the cache or else built and saved.
+ */
+UnwrapMap MapCache::map(const UnwrapParameters& parameters)
+{
+    return map(parameters.center, parameters.innerRadius, parameters.outerRadius,
+               parameters.mapSize(), parameters.invert);
+}
+
+/**
+ * The map of a geometry that doesn't come from UnwrapParameters, such as
+ * the mirror sampled in polar coordinates.
+ */
+UnwrapMap MapCache::map(const QPointF& center, qreal innerRadius, qreal outerRadius, const QSize& size, bool invert)
+{
+    UnwrapMap map;
+    if (find(center, innerRadius, outerRadius, size, invert, map)) {
+        return map;
+    }
+
+    map.build(center, innerRadius, outerRadius, size.width(), size.height(), invert);
+
+    insert(center, innerRadius, outerRadius, size, invert, map);
+    return map;
+}
+
+/**
+ * Loads the saved map of parameters into map, if there is one.
+ */
+bool MapCache::find(const UnwrapParameters& parameters, UnwrapMap& map)
+{
+    return find(parameters.center, parameters.innerRadius, parameters.outerRadius,
+                parameters.mapSize(), parameters.invert, map);
+}
+
+bool MapCache::find(const QPointF& center, qreal innerRadius, qreal outerRadius, const QSize& size, bool invert,
+                    UnwrapMap& map)
+{
+    if (m_directory.isEmpty()) {
+        return false;
+    }
+
+    QMutexLocker locker(&m_mutex);
+
+    QString name = fileName(center, innerRadius, outerRadius, size, invert);
+    UnwrapMap loaded;
+    if (!loaded.load(m_directory + "/" + name)) {
+        return false;
+    }
+
+    // guards against hash collisions
+    if (!loaded.matches(center, innerRadius, outerRadius, size.width(), size.height(), invert)) {
+        return false;
+    }
+
+    map = loaded;
+    touch(name);
+
+    return true;
+}
+
+/**
+ * Saves map as the map of parameters, then makes room.
+ */
+bool MapCache::insert(const UnwrapParameters& parameters, const UnwrapMap& map)
+{
+    return insert(parameters.center, parameters.innerRadius, parameters.outerRadius,
+                  parameters.mapSize(), parameters.invert, map);
+}
+
+bool MapCache::insert(const QPointF& center, qreal innerRadius, qreal outerRadius, const QSize& size, bool invert,
+                      const UnwrapMap& map)
+{
+    if (m_directory.isEmpty() || map.isNull()) {
+        return false;
+    }
+
+    QMutexLocker locker(&m_mutex);
+
+    if (!QDir().mkpath(m_directory)) {
+        return false;
+    }
+
+    // written aside first, so that other processes never see half a map
+    QString name = fileName(center, innerRadius, outerRadius, size, invert);
+    QString path = m_directory + "/" + name;
+    QString temporary = path + ".tmp";
+
+    if (!map.save(temporary)) {
+        return false;
+    }
+
+    QFile::remove(path);
+    if (!QFile::rename(temporary, path)) {
+        QFile::remove(temporary);
+        return false;
+    }
+
+    touch(name);
+    evict(name);
+
+    return true;
+}
+
+QString MapCache::fileName(const QPointF& center, qreal innerRadius, qreal outerRadius, const QSize& size,
+                           bool invert) const
+{
+    QString key = QString("%1 %2 %3 %4 %5 %6 %7 %8")
+            .arg(UnwrapMap::FileVersion)
+            .arg(center.x(), 0, 'g', 17)
+            .arg(center.y(), 0, 'g', 17)
+            .arg(innerRadius, 0, 'g', 17)
+            .arg(outerRadius, 0, 'g', 17)
+            .arg(size.width())
+            .arg(size.height())
+            .arg(invert ? 1 : 0);
+
+    QByteArray hash = QCryptographicHash::hash(key.toLatin1(), QCryptographicHash::Sha1);
+    return QString::fromLatin1(hash.toHex()) + ".map";
+}
+
+/**
+ * Names of the maps from the least to the most recently used.
+ */
+QStringList MapCache::readIndex() const
+{
+    QStringList names;
+
+    QFile file(m_directory + "/" + IndexFileName);
+    if (file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        QTextStream stream(&file);
+        while (!stream.atEnd()) {
+            QString name = stream.readLine().trimmed();
+            if (!name.isEmpty()) {
+                names.append(name);
+            }
+        }
+    }
+
+    return names;
+}
+
+/**
+ * Moves name to the most recently used end of the index.
+ */
+void MapCache::touch(const QString& name)
+{
+    QStringList names = readIndex();
+    names.removeAll(name);
+    names.append(name);
+
+    writeIndex(names);
+}
+
+void MapCache::writeIndex(const QStringList& names) const
+{
+    QFile file(m_directory + "/" + IndexFileName);
+    if (file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        QTextStream stream(&file);
+        foreach (const QString& name, names) {
+            stream << name << "\n";
+        }
+    }
+}
+
+/**
+ * Removes the least recently used maps, but keep, until they fit in
+ * maxSize(). Maps missing from the index go first, oldest first.
+ */
+void MapCache::evict(const QString& keep)
+{
+    QDir dir(m_directory);
+    QFileInfoList files = dir.entryInfoList(QStringList("*.map"), QDir::Files, QDir::Time | QDir::Reversed);
+
+    qint64 total = 0;
+    QMap<QString, qint64> sizes;
+    QStringList order;
+
+    foreach (const QFileInfo& file, files) {
+        total += file.size();
+        sizes.insert(file.fileName(), file.size());
+    }
+
+    if (total <= m_maxSize) {
+        return;
+    }
+
+    QStringList index = readIndex();
+    foreach (const QFileInfo& file, files) {
+        if (!index.contains(file.fileName())) {
+            order.append(file.fileName());
+        }
+    }
+
+    order += index;
+
+    QStringList removed;
+    foreach (const QString& name, order) {
+        if (total <= m_maxSize) {
+            break;
+        }
+
+        if (name == keep || !sizes.contains(name)) {
+            continue;
+        }
+
+        // a map still in use stays mapped until it is dropped
+        if (dir.remove(name)) {
+            total -= sizes.value(name);
+            removed.append(name);
+        }
+    }
+
+    if (!removed.isEmpty()) {
+        foreach (const QString& name, removed) {
+            index.removeAll(name);
+        }
+
+        writeIndex(index);
+    }
+}
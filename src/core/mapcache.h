@@ -0,0 +1,84 @@
+/******************************************************************************
+ *
+ * Copyright (c) 2010 Cláudio F. Gil <claudio.f.gil@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+#ifndef MAPCACHE_H
+#define MAPCACHE_H
+
+#include <QMutex>
+#include <QPointF>
+#include <QSize>
+#include <QString>
+#include <QStringList>
+
+#include "unwrapmap.h"
+
+struct UnwrapParameters;
+
+/**
+ * Directory of saved UnwrapMaps, so that a rig used again starts sampling
+ * without building its map.
+ *
+ * A map is named after everything it is built from: the center, the radii,
+ * the sampled size and the inversion, together with the file version. Maps
+ * are memory-mapped when found. Once the files take more than maxSize()
+ * bytes the least recently used ones are removed; the order of use is kept
+ * in an index file next to them.
+ */
+class MapCache
+{
+public:
+    explicit MapCache(const QString& directory = defaultDirectory());
+
+    enum {
+        DefaultMaxSize = 512 // megabytes
+    };
+
+    static QString defaultDirectory();
+
+    QString directory() const;
+
+    qint64 maxSize() const;
+    void setMaxSize(qint64 bytes);
+
+    UnwrapMap map(const UnwrapParameters& parameters);
+    UnwrapMap map(const QPointF& center, qreal innerRadius, qreal outerRadius, const QSize& size, bool invert);
+    bool find(const UnwrapParameters& parameters, UnwrapMap& map);
+    bool insert(const UnwrapParameters& parameters, const UnwrapMap& map);
+
+private:
+    QString m_directory;
+    qint64 m_maxSize;
+    QMutex m_mutex;
+
+    bool find(const QPointF& center, qreal innerRadius, qreal outerRadius, const QSize& size, bool invert,
+              UnwrapMap& map);
+    bool insert(const QPointF& center, qreal innerRadius, qreal outerRadius, const QSize& size, bool invert,
+                const UnwrapMap& map);
+    QString fileName(const QPointF& center, qreal innerRadius, qreal outerRadius, const QSize& size,
+                     bool invert) const;
+    QStringList readIndex() const;
+    void writeIndex(const QStringList& names) const;
+    void touch(const QString& name);
+    void evict(const QString& keep);
+};
+
+#endif // MAPCACHE_H
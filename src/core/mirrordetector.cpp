@@ -0,0 +1,751 @@
+/******************************************************************************
+ *
+ * Copyright (c) 2010 Cláudio F. Gil <claudio.f.gil@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+#include <QAtomicInt>
+#include <QImageReader>
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
+#include <QVector>
+#include <qmath.h>
+
+#include <algorithm>
+
+#include "mirrordetector.h"
+#include "sourcepyramid.h"
+#include "unwrapper.h"
+
+// share of the pixels kept as edges
+static const qreal EdgeFraction = 0.04;
+
+// edges don't vote for centers closer than this, in working pixels
+static const int MinVoteDistance = 3;
+
+static const int Sectors = 36;
+static const int SamplesPerSector = 20;
+
+// rays cast to find the edge points of a ring, and the rounds of fitting
+static const int Rays = 360;
+static const int FitRounds = 4;
+
+// how far from the current circle the first round looks for the edge
+static const qreal FitWindow = 40;
+static const qreal FinalWindow = 6;
+
+/**
+ * Sobel gradients of gray, zero on the border.
+ */
+static void sobel(const uchar* gray, int width, int height, int bytesPerLine,
+                  QVector<float>& gx, QVector<float>& gy)
+{
+    gx.fill(0, width * height);
+    gy.fill(0, width * height);
+
+    for (int y = 1; y < height - 1; y++) {
+        const uchar* p0 = gray + (y - 1) * bytesPerLine;
+        const uchar* p1 = p0 + bytesPerLine;
+        const uchar* p2 = p1 + bytesPerLine;
+
+        for (int x = 1; x < width - 1; x++) {
+            gx[y * width + x] = (p0[x + 1] + 2 * p1[x + 1] + p2[x + 1]) - (p0[x - 1] + 2 * p1[x - 1] + p2[x - 1]);
+            gy[y * width + x] = (p2[x - 1] + 2 * p2[x] + p2[x + 1]) - (p0[x - 1] + 2 * p0[x] + p0[x + 1]);
+        }
+    }
+}
+
+/**
+ * Worker voting for the centers along the gradients of edges, a chunk at a
+ * time, into its own accumulator.
+ */
+class VoteEdges : public QRunnable
+{
+public:
+    enum {
+        ChunkSize = 1024
+    };
+
+    VoteEdges(const QVector<int>* edges, const QVector<float>* gx, const QVector<float>* gy,
+              int width, int height, QVector<int>* votes, QAtomicInt* nextChunk) :
+        m_edges(edges), m_gx(gx), m_gy(gy),
+        m_width(width), m_height(height), m_votes(votes), m_nextChunk(nextChunk)
+    {
+        setAutoDelete(false);
+    }
+
+    void run()
+    {
+        int count = m_edges->size();
+        int* votes = m_votes->data();
+
+        for (;;) {
+            int first = m_nextChunk->fetchAndAddOrdered(1) * ChunkSize;
+            if (first >= count) {
+                break;
+            }
+
+            int last = qMin(first + ChunkSize, count);
+
+            for (int i = first; i < last; i++) {
+                int edge = m_edges->at(i);
+                int x = edge % m_width;
+                int y = edge / m_width;
+
+                float gx = m_gx->at(edge);
+                float gy = m_gy->at(edge);
+                float length = qSqrt(gx * gx + gy * gy);
+                float ux = gx / length;
+                float uy = gy / length;
+
+                // the center is on one side or the other of the edge
+                for (int sign = -1; sign <= 1; sign += 2) {
+                    for (int t = MinVoteDistance; ; t++) {
+                        int px = qRound(x + sign * t * ux);
+                        int py = qRound(y + sign * t * uy);
+
+                        if (px < 0 || py < 0 || px >= m_width || py >= m_height) {
+                            break;
+                        }
+
+                        votes[py * m_width + px]++;
+                    }
+                }
+            }
+        }
+    }
+
+private:
+    const QVector<int>* m_edges;
+    const QVector<float>* m_gx;
+    const QVector<float>* m_gy;
+    int m_width;
+    int m_height;
+    QVector<int>* m_votes;
+    QAtomicInt* m_nextChunk;
+};
+
+/**
+ * Position of the strongest 5x5 neighbourhood of votes, refined to the
+ * centroid of its votes.
+ */
+static QPointF votePeak(const QVector<int>& votes, int width, int height)
+{
+    // sums of 5 pixels across, then of 5 of those down
+    QVector<int> rows(width * height, 0);
+    for (int y = 0; y < height; y++) {
+        const int* line = votes.constData() + y * width;
+        for (int x = 2; x < width - 2; x++) {
+            rows[y * width + x] = line[x - 2] + line[x - 1] + line[x] + line[x + 1] + line[x + 2];
+        }
+    }
+
+    int best = -1;
+    int bestX = width / 2;
+    int bestY = height / 2;
+
+    for (int y = 2; y < height - 2; y++) {
+        for (int x = 2; x < width - 2; x++) {
+            int sum = 0;
+            for (int j = -2; j <= 2; j++) {
+                sum += rows[(y + j) * width + x];
+            }
+
+            if (sum > best) {
+                best = sum;
+                bestX = x;
+                bestY = y;
+            }
+        }
+    }
+
+    qreal total = 0;
+    qreal sx = 0;
+    qreal sy = 0;
+
+    for (int y = qMax(0, bestY - 2); y <= qMin(height - 1, bestY + 2); y++) {
+        for (int x = qMax(0, bestX - 2); x <= qMin(width - 1, bestX + 2); x++) {
+            int v = votes[y * width + x];
+            total += v;
+            sx += v * x;
+            sy += v * y;
+        }
+    }
+
+    if (total <= 0) {
+        return QPointF(bestX, bestY);
+    }
+
+    return QPointF(sx / total, sy / total);
+}
+
+/**
+ * Gradients of the working image and what is measured on them.
+ */
+struct EdgeField
+{
+    EdgeField(int w, int h) :
+        width(w), height(h), cosines(Sectors * SamplesPerSector), sines(Sectors * SamplesPerSector)
+    {
+        for (int a = 0; a < cosines.size(); a++) {
+            qreal angle = (2 * M_PI * (a + 0.5)) / cosines.size();
+            cosines[a] = qCos(angle);
+            sines[a] = qSin(angle);
+        }
+    }
+
+    int width;
+    int height;
+    QVector<float> gx;
+    QVector<float> gy;
+    QVector<qreal> cosines;
+    QVector<qreal> sines;
+
+    qreal ring(const QPointF& center, qreal radius) const;
+    QVector<qreal> profile(const QPointF& center, int maxRadius) const;
+    qreal radialGradient(qreal x, qreal y, qreal c, qreal s) const;
+    QVector<QPointF> edgePoints(const QPointF& center, qreal radius, qreal window) const;
+};
+
+/**
+ * Radial edge strength of the circle of radius around center: the median
+ * over the sectors inside the image of their mean radial gradient. An edge
+ * seen by most sectors is circular and centered.
+ */
+qreal EdgeField::ring(const QPointF& center, qreal radius) const
+{
+    qreal means[Sectors];
+    int sectors = 0;
+
+    for (int s = 0; s < Sectors; s++) {
+        qreal sum = 0;
+        int count = 0;
+
+        for (int a = s * SamplesPerSector; a < (s + 1) * SamplesPerSector; a++) {
+            int x = qRound(center.x() + radius * cosines[a]);
+            int y = qRound(center.y() + radius * sines[a]);
+
+            if (x < 1 || y < 1 || x >= width - 1 || y >= height - 1) {
+                continue;
+            }
+
+            int i = y * width + x;
+            sum += qAbs(gx[i] * cosines[a] + gy[i] * sines[a]);
+            count++;
+        }
+
+        if (count * 2 >= SamplesPerSector) {
+            means[sectors++] = sum / count;
+        }
+    }
+
+    if (sectors * 3 < Sectors) {
+        return 0;
+    }
+
+    std::nth_element(means, means + sectors / 2, means + sectors);
+    return means[sectors / 2];
+}
+
+/**
+ * Ring strength at every whole radius up to maxRadius.
+ */
+QVector<qreal> EdgeField::profile(const QPointF& center, int maxRadius) const
+{
+    QVector<qreal> result(maxRadius + 1, 0);
+    for (int r = 1; r <= maxRadius; r++) {
+        result[r] = ring(center, r);
+    }
+
+    return result;
+}
+
+/**
+ * Radial gradient at x, y along the direction c, s, interpolated.
+ */
+qreal EdgeField::radialGradient(qreal x, qreal y, qreal c, qreal s) const
+{
+    int ix = qFloor(x);
+    int iy = qFloor(y);
+    if (ix < 1 || iy < 1 || ix >= width - 2 || iy >= height - 2) {
+        return 0;
+    }
+
+    qreal fx = x - ix;
+    qreal fy = y - iy;
+    int i = iy * width + ix;
+
+    qreal g0 = (gx[i] * (1 - fx) + gx[i + 1] * fx) * (1 - fy) + (gx[i + width] * (1 - fx) + gx[i + width + 1] * fx) * fy;
+    qreal g1 = (gy[i] * (1 - fx) + gy[i + 1] * fx) * (1 - fy) + (gy[i + width] * (1 - fx) + gy[i + width + 1] * fx) * fy;
+
+    return qAbs(g0 * c + g1 * s);
+}
+
+/**
+ * Points of the strongest radial edge along rays from center, within
+ * window of radius.
+ */
+QVector<QPointF> EdgeField::edgePoints(const QPointF& center, qreal radius, qreal window) const
+{
+    QVector<QPointF> points;
+
+    for (int a = 0; a < Rays; a++) {
+        qreal angle = (2 * M_PI * a) / Rays;
+        qreal c = qCos(angle);
+        qreal s = qSin(angle);
+
+        qreal best = 0;
+        qreal bestR = -1;
+        qreal previous = 0;
+        qreal current = 0;
+
+        int first = qMax(1, qFloor(radius - window));
+        int last = qCeil(radius + window);
+
+        for (int r = first; r <= last + 1; r++) {
+            qreal next = radialGradient(center.x() + r * c, center.y() + r * s, c, s);
+
+            // a local maximum at r - 1, placed between its neighbours
+            if (r - 1 > first && current > best && current >= previous && current >= next) {
+                qreal d = previous - 2 * current + next;
+                best = current;
+                bestR = r - 1 + (d < 0 ? 0.5 * (previous - next) / d : 0);
+            }
+
+            previous = current;
+            current = next;
+        }
+
+        if (bestR > 0) {
+            points.append(QPointF(center.x() + bestR * c, center.y() + bestR * s));
+        }
+    }
+
+    return points;
+}
+
+/**
+ * Radius of the highest point of profile, excluding radii closer than gap
+ * to avoid, refined between its neighbours.
+ */
+static qreal profilePeak(const QVector<qreal>& profile, int minRadius, int avoid, int gap, qreal* strength)
+{
+    int best = -1;
+
+    for (int r = minRadius; r < profile.size(); r++) {
+        if (avoid >= 0 && qAbs(r - avoid) < gap) {
+            continue;
+        }
+
+        if (best < 0 || profile[r] > profile[best]) {
+            best = r;
+        }
+    }
+
+    if (best < 0) {
+        *strength = 0;
+        return 0;
+    }
+
+    *strength = profile[best];
+
+    if (best <= 0 || best + 1 >= profile.size()) {
+        return best;
+    }
+
+    // vertex of the parabola through the peak and its neighbours
+    qreal a = profile[best - 1];
+    qreal b = profile[best];
+    qreal c = profile[best + 1];
+    qreal d = a - 2 * b + c;
+
+    return d < 0 ? best + 0.5 * (a - c) / d : best;
+}
+
+/**
+ * Least squares circle through points, solving for x^2 + y^2 + Dx + Ey + F
+ * = 0. Returns false if the points are too few or in a line.
+ */
+bool MirrorDetector::fitCircle(const QVector<QPointF>& points, QPointF& center, qreal& radius)
+{
+    if (points.size() < 8) {
+        return false;
+    }
+
+    // relative to the mean, for precision
+    qreal mx = 0;
+    qreal my = 0;
+    foreach (const QPointF& p, points) {
+        mx += p.x();
+        my += p.y();
+    }
+    mx /= points.size();
+    my /= points.size();
+
+    qreal sxx = 0, sxy = 0, syy = 0, sx = 0, sy = 0;
+    qreal sxz = 0, syz = 0, sz = 0;
+    foreach (const QPointF& p, points) {
+        qreal x = p.x() - mx;
+        qreal y = p.y() - my;
+        qreal z = x * x + y * y;
+
+        sxx += x * x;
+        sxy += x * y;
+        syy += y * y;
+        sx += x;
+        sy += y;
+        sxz += x * z;
+        syz += y * z;
+        sz += z;
+    }
+
+    qreal n = points.size();
+
+    // normal equations of D, E, F, solved by Cramer's rule
+    qreal m[3][3] = { { sxx, sxy, sx }, { sxy, syy, sy }, { sx, sy, n } };
+    qreal v[3] = { -sxz, -syz, -sz };
+
+    qreal det = m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1])
+            - m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0])
+            + m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+    if (qAbs(det) < 1e-9) {
+        return false;
+    }
+
+    qreal solution[3];
+    for (int k = 0; k < 3; k++) {
+        qreal c[3][3];
+        for (int i = 0; i < 3; i++) {
+            for (int j = 0; j < 3; j++) {
+                c[i][j] = j == k ? v[i] : m[i][j];
+            }
+        }
+
+        solution[k] = (c[0][0] * (c[1][1] * c[2][2] - c[1][2] * c[2][1])
+                       - c[0][1] * (c[1][0] * c[2][2] - c[1][2] * c[2][0])
+                       + c[0][2] * (c[1][0] * c[2][1] - c[1][1] * c[2][0])) / det;
+    }
+
+    qreal cx = -solution[0] / 2;
+    qreal cy = -solution[1] / 2;
+    qreal r2 = cx * cx + cy * cy - solution[2];
+    if (r2 <= 0) {
+        return false;
+    }
+
+    center = QPointF(cx + mx, cy + my);
+    radius = qSqrt(r2);
+
+    return true;
+}
+
+/**
+ * Fits the ring near center and radius, looking closer to the current
+ * circle every round and dropping points far from it.
+ */
+static void refineCircle(const EdgeField& field, QPointF& center, qreal& radius)
+{
+    qreal window = FitWindow;
+
+    for (int round = 0; round < FitRounds; round++) {
+        QVector<QPointF> points = field.edgePoints(center, radius, window);
+
+        // keep the points within three median deviations of the circle
+        QVector<qreal> residuals;
+        foreach (const QPointF& p, points) {
+            qreal dx = p.x() - center.x();
+            qreal dy = p.y() - center.y();
+            residuals.append(qAbs(qSqrt(dx * dx + dy * dy) - radius));
+        }
+
+        if (!residuals.isEmpty()) {
+            QVector<qreal> sorted = residuals;
+            std::nth_element(sorted.begin(), sorted.begin() + sorted.size() / 2, sorted.end());
+            qreal limit = qMax(qreal(1), 3 * sorted[sorted.size() / 2]);
+
+            QVector<QPointF> kept;
+            for (int i = 0; i < points.size(); i++) {
+                if (residuals[i] <= limit) {
+                    kept.append(points[i]);
+                }
+            }
+
+            points = kept;
+        }
+
+        QPointF fittedCenter;
+        qreal fittedRadius;
+        if (!MirrorDetector::fitCircle(points, fittedCenter, fittedRadius)) {
+            return;
+        }
+
+        center = fittedCenter;
+        radius = fittedRadius;
+        window = qMax(FinalWindow, window / 2);
+    }
+}
+
+/**
+ * Median distance from center of the edge points near radius.
+ */
+static qreal ringRadius(const EdgeField& field, const QPointF& center, qreal radius)
+{
+    QVector<QPointF> points = field.edgePoints(center, radius, FinalWindow);
+    if (points.isEmpty()) {
+        return radius;
+    }
+
+    QVector<qreal> radii;
+    foreach (const QPointF& p, points) {
+        qreal dx = p.x() - center.x();
+        qreal dy = p.y() - center.y();
+        radii.append(qSqrt(dx * dx + dy * dy));
+    }
+
+    std::nth_element(radii.begin(), radii.begin() + radii.size() / 2, radii.end());
+    return radii[radii.size() / 2];
+}
+
+MirrorDetector::MirrorDetector() :
+    m_innerRadius(0),
+    m_outerRadius(0),
+    m_threadCount(0)
+{
+}
+
+int MirrorDetector::threadCount() const
+{
+    return m_threadCount;
+}
+
+void MirrorDetector::setThreadCount(int threads)
+{
+    m_threadCount = qMax(0, threads);
+}
+
+/**
+ * Detects the mirror in the image file at path. Large files are decoded
+ * already reduced, which JPEG files do while decoding.
+ */
+bool MirrorDetector::detect(const QString& path)
+{
+    QImageReader reader(path);
+    QSize size = reader.size();
+
+    if (!size.isValid() || qMax(size.width(), size.height()) <= WorkingSize) {
+        QImage image;
+        return reader.read(&image) && detect(image);
+    }
+
+    qreal scale = qreal(WorkingSize) / qMax(size.width(), size.height());
+    QSize scaledSize(qMax(1, qRound(size.width() * scale)), qMax(1, qRound(size.height() * scale)));
+    reader.setScaledSize(scaledSize);
+
+    QImage image;
+    if (!reader.read(&image)) {
+        return false;
+    }
+
+    return detect(image, qreal(scaledSize.width()) / size.width());
+}
+
+bool MirrorDetector::detect(const QImage& image)
+{
+    SourcePyramid pyramid(image);
+    return detect(&pyramid);
+}
+
+/**
+ * Detects the mirror in the first level of pyramid small enough to work
+ * on, building it if needed.
+ */
+bool MirrorDetector::detect(SourcePyramid* pyramid)
+{
+    int level = 0;
+    QImage image = pyramid->level(0);
+
+    while (qMax(image.width(), image.height()) > WorkingSize && level + 1 < SourcePyramid::MaxLevels) {
+        level++;
+        image = pyramid->level(level);
+    }
+
+    return detect(image, SourcePyramid::levelScale(level));
+}
+
+/**
+ * Detects the mirror in image, which is the source reduced by scale, and
+ * gives the results in source pixels.
+ */
+bool MirrorDetector::detect(const QImage& image, qreal scale)
+{
+    if (image.isNull()) {
+        return false;
+    }
+
+    QImage rgb = image.convertToFormat(QImage::Format_RGB32);
+    QVector<uchar> gray(rgb.width() * rgb.height());
+
+    for (int y = 0; y < rgb.height(); y++) {
+        const QRgb* line = (const QRgb*) rgb.constScanLine(y);
+        uchar* out = gray.data() + y * rgb.width();
+
+        for (int x = 0; x < rgb.width(); x++) {
+            out[x] = qGray(line[x]);
+        }
+    }
+
+    if (!detect(gray.constData(), rgb.width(), rgb.height(), rgb.width())) {
+        return false;
+    }
+
+    m_center = QPointF((m_center.x() + 0.5) / scale - 0.5, (m_center.y() + 0.5) / scale - 0.5);
+    m_innerRadius /= scale;
+    m_outerRadius /= scale;
+
+    return true;
+}
+
+/**
+ * Detects the mirror in an 8 bit gray image, giving the results in its
+ * pixels. Returns false if no circular edge stands out.
+ */
+bool MirrorDetector::detect(const uchar* gray, int width, int height, int bytesPerLine)
+{
+    if (width < 16 || height < 16) {
+        return false;
+    }
+
+    EdgeField field(width, height);
+    sobel(gray, width, height, bytesPerLine, field.gx, field.gy);
+    const QVector<float>& gx = field.gx;
+    const QVector<float>& gy = field.gy;
+
+    // the strongest edges
+    QVector<float> magnitudes(width * height);
+    for (int i = 0; i < magnitudes.size(); i++) {
+        magnitudes[i] = qAbs(gx[i]) + qAbs(gy[i]);
+    }
+
+    QVector<float> sorted = magnitudes;
+    int nth = qBound(0, int(sorted.size() * (1 - EdgeFraction)), sorted.size() - 1);
+    std::nth_element(sorted.begin(), sorted.begin() + nth, sorted.end());
+    float threshold = qMax(sorted[nth], 1.0f);
+
+    QVector<int> edges;
+    for (int i = 0; i < magnitudes.size(); i++) {
+        if (magnitudes[i] >= threshold) {
+            edges.append(i);
+        }
+    }
+
+    if (edges.isEmpty()) {
+        return false;
+    }
+
+    // every worker votes in its own accumulator
+    int chunks = (edges.size() + VoteEdges::ChunkSize - 1) / VoteEdges::ChunkSize;
+    int threads = qBound(1, m_threadCount > 0 ? m_threadCount : QThread::idealThreadCount(), chunks);
+
+    QVector<QVector<int> > votes(threads);
+    QVector<VoteEdges*> workers;
+    QAtomicInt nextChunk(0);
+    QThreadPool pool;
+    pool.setMaxThreadCount(threads);
+
+    for (int i = 0; i < threads; i++) {
+        votes[i].fill(0, width * height);
+        workers.append(new VoteEdges(&edges, &gx, &gy, width, height, &votes[i], &nextChunk));
+    }
+
+    for (int i = 1; i < threads; i++) {
+        pool.start(workers[i]);
+    }
+
+    workers[0]->run();
+    pool.waitForDone();
+    qDeleteAll(workers);
+
+    QVector<int>& total = votes[0];
+    for (int i = 1; i < threads; i++) {
+        for (int j = 0; j < total.size(); j++) {
+            total[j] += votes[i][j];
+        }
+    }
+
+    QPointF center = votePeak(total, width, height);
+
+    int maxRadius = qCeil(qSqrt(qreal(width) * width + qreal(height) * height));
+    int minRadius = 4;
+    int gap = qMax(4, qMin(width, height) / 20);
+
+    qreal strength = 0;
+    qreal radius = profilePeak(field.profile(center, maxRadius), minRadius, -1, gap, &strength);
+    if (strength < 1) {
+        return false;
+    }
+
+    // other edges blur the votes: fit the strongest ring instead
+    refineCircle(field, center, radius);
+
+    // the other rim shares the center
+    QVector<qreal> profile = field.profile(center, maxRadius);
+    strength = profile[qBound(0, qRound(radius), profile.size() - 1)];
+
+    qreal secondStrength = 0;
+    qreal second = profilePeak(profile, minRadius, qRound(radius), gap, &secondStrength);
+    second = ringRadius(field, center, second);
+
+    m_center = center;
+    m_outerRadius = qMax(radius, second);
+    m_innerRadius = qMin(radius, second);
+
+    // without a clear second edge, the inner one is only a guess
+    if (secondStrength < strength / 4) {
+        m_outerRadius = radius;
+        m_innerRadius = radius / 4;
+    }
+
+    return true;
+}
+
+QPointF MirrorDetector::center() const
+{
+    return m_center;
+}
+
+qreal MirrorDetector::innerRadius() const
+{
+    return m_innerRadius;
+}
+
+qreal MirrorDetector::outerRadius() const
+{
+    return m_outerRadius;
+}
+
+/**
+ * Sets the geometry of parameters to the detected mirror.
+ */
+void MirrorDetector::apply(UnwrapParameters& parameters) const
+{
+    parameters.center = m_center;
+    parameters.innerRadius = m_innerRadius;
+    parameters.outerRadius = m_outerRadius;
+}
@@ -0,0 +1,81 @@
+/******************************************************************************
+ *
+ * Copyright (c) 2010 Cláudio F. Gil <claudio.f.gil@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+#ifndef MIRRORDETECTOR_H
+#define MIRRORDETECTOR_H
+
+#include <QImage>
+#include <QPointF>
+#include <QString>
+#include <QVector>
+
+struct UnwrapParameters;
+class SourcePyramid;
+
+/**
+ * Finds the mirror in a source image: its center and the radii of its
+ * inner and outer edges.
+ *
+ * The image is reduced to at most WorkingSize pixels on its longest side.
+ * Every strong edge votes for the centers along its gradient, as all the
+ * edges of a circle point at its center. Around the winning center the
+ * radial edge strength is measured in sectors, and the radii where most
+ * sectors agree on an edge are the rims of the mirror. The strongest rim
+ * is then fitted with a circle through its edge points, which gives the
+ * center to a fraction of a pixel. Voting is spread over threadCount()
+ * threads, all the cores if it is zero.
+ */
+class MirrorDetector
+{
+public:
+    MirrorDetector();
+
+    enum {
+        WorkingSize = 1024
+    };
+
+    bool detect(const QString& path);
+    bool detect(const QImage& image);
+    bool detect(SourcePyramid* pyramid);
+    bool detect(const uchar* gray, int width, int height, int bytesPerLine);
+
+    int threadCount() const;
+    void setThreadCount(int threads);
+
+    QPointF center() const;
+    qreal innerRadius() const;
+    qreal outerRadius() const;
+
+    void apply(UnwrapParameters& parameters) const;
+
+    static bool fitCircle(const QVector<QPointF>& points, QPointF& center, qreal& radius);
+
+private:
+    QPointF m_center;
+    qreal m_innerRadius;
+    qreal m_outerRadius;
+    int m_threadCount;
+
+    bool detect(const QImage& image, qreal scale);
+};
+
+#endif // MIRRORDETECTOR_H
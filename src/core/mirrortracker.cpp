@@ -0,0 +1,283 @@
+/******************************************************************************
+ *
+ * Copyright (c) 2010 Cláudio F. Gil <claudio.f.gil@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+#include <QVector>
+#include <qmath.h>
+
+#include <algorithm>
+
+#include "mirrortracker.h"
+#include "mirrordetector.h"
+#include "unwrapper.h"
+
+// rays whose edge is weaker than this share of the median are left out
+static const qreal WeakEdge = 0.25;
+
+// median edge strength, in gray levels, below which the rim is lost
+static const qreal MinStrength = 4;
+
+/**
+ * Gray level at (x, y), interpolated between the four nearest pixels of a
+ * 32 bit image, or -1 outside of it.
+ */
+static inline qreal grayAt(const QImage& image, qreal x, qreal y)
+{
+    int x0 = qFloor(x);
+    int y0 = qFloor(y);
+    if (x0 < 0 || y0 < 0 || x0 + 1 >= image.width() || y0 + 1 >= image.height()) {
+        return -1;
+    }
+
+    qreal fx = x - x0;
+    qreal fy = y - y0;
+
+    const QRgb* top = (const QRgb*) image.constScanLine(y0) + x0;
+    const QRgb* bottom = (const QRgb*) image.constScanLine(y0 + 1) + x0;
+
+    return (qGray(top[0]) * (1 - fx) + qGray(top[1]) * fx) * (1 - fy)
+            + (qGray(bottom[0]) * (1 - fx) + qGray(bottom[1]) * fx) * fy;
+}
+
+static qreal pointDistance(const QPointF& a, const QPointF& b)
+{
+    qreal dx = a.x() - b.x();
+    qreal dy = a.y() - b.y();
+    return qSqrt(dx * dx + dy * dy);
+}
+
+MirrorTracker::MirrorTracker() :
+    m_innerRadius(0),
+    m_outerRadius(0),
+    m_hasReference(false),
+    m_referenceRadius(0),
+    m_edgeRadius(0)
+{
+}
+
+/**
+ * Starts over from the given geometry, for instance the one saved for the
+ * size of the frames. The rim is looked for near outerRadius.
+ */
+void MirrorTracker::reset(const QPointF& center, qreal innerRadius, qreal outerRadius)
+{
+    m_center = center;
+    m_innerRadius = innerRadius;
+    m_outerRadius = outerRadius;
+    m_hasReference = false;
+}
+
+/**
+ * Finds the rim in frame near where it was in the previous one. Returns
+ * false, keeping the last geometry, if it is not clearly there or moved
+ * more than Band pixels.
+ */
+bool MirrorTracker::track(const QImage& frame)
+{
+    if (frame.isNull() || m_outerRadius <= 0) {
+        return false;
+    }
+
+    QImage image = frame;
+    if (image.format() != QImage::Format_RGB32 && image.format() != QImage::Format_ARGB32
+            && image.format() != QImage::Format_ARGB32_Premultiplied) {
+        image = image.convertToFormat(QImage::Format_RGB32);
+    }
+
+    QPointF start = m_hasReference ? m_edgeCenter : m_center;
+    qreal startRadius = m_hasReference ? m_edgeRadius : m_outerRadius;
+
+    // a wide band to catch the movement, then a narrow one for precision
+    QPointF center = start;
+    qreal radius = startRadius;
+    if (!fitEdge(image, center, radius, Band) || !fitEdge(image, center, radius, Band / 4)) {
+        return false;
+    }
+
+    // further away it is more likely another edge than the rim
+    if (pointDistance(center, start) > Band || qAbs(radius - startRadius) > Band) {
+        return false;
+    }
+
+    if (!m_hasReference) {
+        m_referenceCenter = center;
+        m_referenceRadius = radius;
+        m_hasReference = true;
+    }
+
+    m_edgeCenter = center;
+    m_edgeRadius = radius;
+
+    return true;
+}
+
+/**
+ * Fits a circle through the strongest radial edge on each ray, within band
+ * of center and radius, which are updated.
+ */
+bool MirrorTracker::fitEdge(const QImage& frame, QPointF& center, qreal& radius, qreal band) const
+{
+    QVector<QPointF> points;
+    QVector<qreal> strengths;
+
+    int first = qMax(1, qFloor(radius - band));
+    int last = qCeil(radius + band);
+    QVector<qreal> values(last - first + 3);
+
+    for (int a = 0; a < Rays; a++) {
+        qreal angle = (2 * M_PI * a) / Rays;
+        qreal c = qCos(angle);
+        qreal s = qSin(angle);
+
+        // rays leaving the frame, where the mirror is cut, are left out
+        bool inside = true;
+        for (int i = 0; i < values.size() && inside; i++) {
+            qreal r = first - 1 + i;
+            values[i] = grayAt(frame, center.x() + r * c, center.y() + r * s);
+            inside = values[i] >= 0;
+        }
+
+        if (!inside) {
+            continue;
+        }
+
+        // central differences, the strongest placed between its neighbours
+        qreal best = 0;
+        int bestIndex = -1;
+        for (int i = 1; i + 1 < values.size(); i++) {
+            qreal d = qAbs(values[i + 1] - values[i - 1]);
+            if (d > best) {
+                best = d;
+                bestIndex = i;
+            }
+        }
+
+        if (bestIndex < 0) {
+            continue;
+        }
+
+        qreal offset = 0;
+        if (bestIndex > 1 && bestIndex + 2 < values.size()) {
+            qreal p = qAbs(values[bestIndex] - values[bestIndex - 2]);
+            qreal n = qAbs(values[bestIndex + 2] - values[bestIndex]);
+            qreal d = p - 2 * best + n;
+            offset = d < 0 ? 0.5 * (p - n) / d : 0;
+        }
+
+        qreal r = first - 1 + bestIndex + offset;
+        points.append(QPointF(center.x() + r * c, center.y() + r * s));
+        strengths.append(best);
+    }
+
+    if (points.size() < Rays / 4) {
+        return false;
+    }
+
+    QVector<qreal> sorted = strengths;
+    std::nth_element(sorted.begin(), sorted.begin() + sorted.size() / 2, sorted.end());
+    qreal median = sorted[sorted.size() / 2];
+    if (median < MinStrength) {
+        return false;
+    }
+
+    // drop weak edges, then the points far from the circle through the rest
+    QVector<QPointF> strong;
+    QVector<qreal> residuals;
+    for (int i = 0; i < points.size(); i++) {
+        if (strengths[i] >= WeakEdge * median) {
+            strong.append(points[i]);
+            residuals.append(qAbs(pointDistance(points[i], center) - radius));
+        }
+    }
+
+    if (strong.size() < Rays / 4) {
+        return false;
+    }
+
+    sorted = residuals;
+    std::nth_element(sorted.begin(), sorted.begin() + sorted.size() / 2, sorted.end());
+    qreal limit = qMax(qreal(1), 3 * sorted[sorted.size() / 2]);
+
+    QVector<QPointF> kept;
+    for (int i = 0; i < strong.size(); i++) {
+        if (residuals[i] <= limit) {
+            kept.append(strong[i]);
+        }
+    }
+
+    if (kept.size() < Rays / 4) {
+        return false;
+    }
+
+    return MirrorDetector::fitCircle(kept, center, radius);
+}
+
+/**
+ * Center of the mirror, moved with the rim since the first tracked frame.
+ */
+QPointF MirrorTracker::center() const
+{
+    if (!m_hasReference) {
+        return m_center;
+    }
+
+    return m_center + (m_edgeCenter - m_referenceCenter);
+}
+
+qreal MirrorTracker::innerRadius() const
+{
+    if (!m_hasReference || m_referenceRadius <= 0) {
+        return m_innerRadius;
+    }
+
+    return m_innerRadius * m_edgeRadius / m_referenceRadius;
+}
+
+qreal MirrorTracker::outerRadius() const
+{
+    if (!m_hasReference || m_referenceRadius <= 0) {
+        return m_outerRadius;
+    }
+
+    return m_outerRadius * m_edgeRadius / m_referenceRadius;
+}
+
+/**
+ * How far, in pixels, a point of either circle of parameters is at most
+ * from the tracked ones.
+ */
+qreal MirrorTracker::distance(const UnwrapParameters& parameters) const
+{
+    qreal radii = qMax(qAbs(parameters.innerRadius - innerRadius()),
+                       qAbs(parameters.outerRadius - outerRadius()));
+
+    return pointDistance(parameters.center, center()) + radii;
+}
+
+/**
+ * Sets the geometry of parameters to the tracked mirror.
+ */
+void MirrorTracker::apply(UnwrapParameters& parameters) const
+{
+    parameters.center = center();
+    parameters.innerRadius = innerRadius();
+    parameters.outerRadius = outerRadius();
+}
@@ -0,0 +1,77 @@
+/******************************************************************************
+ *
+ * Copyright (c) 2010 Cláudio F. Gil <claudio.f.gil@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+#ifndef MIRRORTRACKER_H
+#define MIRRORTRACKER_H
+
+#include <QImage>
+#include <QPointF>
+
+struct UnwrapParameters;
+
+/**
+ * Follows the mirror from one frame to the next, for rigs that move a
+ * little during a video or a burst of photos.
+ *
+ * Only a narrow band around the last known outer edge is looked at: rays
+ * cross it, the strongest radial edge on each is kept and a circle is
+ * fitted through them. This costs a few thousand samples per frame, far
+ * less than a detection, so it runs inline with the decoding. The given
+ * geometry moves and scales with the fitted edge, which keeps any offset
+ * between the circles and the actual rim.
+ */
+class MirrorTracker
+{
+public:
+    MirrorTracker();
+
+    enum {
+        Rays = 180,
+        Band = 16
+    };
+
+    void reset(const QPointF& center, qreal innerRadius, qreal outerRadius);
+    bool track(const QImage& frame);
+
+    QPointF center() const;
+    qreal innerRadius() const;
+    qreal outerRadius() const;
+
+    qreal distance(const UnwrapParameters& parameters) const;
+    void apply(UnwrapParameters& parameters) const;
+
+private:
+    QPointF m_center;
+    qreal m_innerRadius;
+    qreal m_outerRadius;
+
+    // the rim in the first tracked frame and in the last one
+    bool m_hasReference;
+    QPointF m_referenceCenter;
+    qreal m_referenceRadius;
+    QPointF m_edgeCenter;
+    qreal m_edgeRadius;
+
+    bool fitEdge(const QImage& frame, QPointF& center, qreal& radius, qreal band) const;
+};
+
+#endif // MIRRORTRACKER_H
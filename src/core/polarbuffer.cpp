@@ -0,0 +1,142 @@
+/******************************************************************************
+ *
+ * Copyright (c) 2010 Cláudio F. Gil <claudio.f.gil@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+#include <QPainter>
+#include <qmath.h>
+
+#include "polarbuffer.h"
+
+PolarBuffer::PolarBuffer() :
+    m_sourceKey(0),
+    m_innerRadius(0),
+    m_outerRadius(0),
+    m_interpolation(Unwrapper::BilinearInterpolation)
+{
+}
+
+/**
+ * Size of the buffer for the geometry of parameters: the circumference of
+ * the outer circle by the width of the ring, so that no part of the mirror
+ * loses resolution.
+ */
+QSize PolarBuffer::size(const UnwrapParameters& parameters)
+{
+    qreal ring = parameters.outerRadius - parameters.innerRadius;
+    if (parameters.outerRadius <= 0 || ring <= 0) {
+        return QSize();
+    }
+
+    return QSize(qCeil(2 * M_PI * parameters.outerRadius), qCeil(ring));
+}
+
+/**
+ * Fraction of the source resolution the final image of parameters needs
+ * from the buffer, either around the outer circle or along a radius.
+ */
+qreal PolarBuffer::sourceScale(const UnwrapParameters& parameters)
+{
+    qreal ring = parameters.outerRadius - parameters.innerRadius;
+    if (parameters.outerRadius <= 0 || ring <= 0) {
+        return 1;
+    }
+
+    qreal around = parameters.finalWidth / (2 * M_PI * parameters.outerRadius);
+    qreal along = parameters.scaledHeight() / ring;
+
+    return qMin(qreal(1), qMax(around, along));
+}
+
+/**
+ * Whether the buffer holds the mirror of parameters in the source with the
+ * given cache key.
+ */
+bool PolarBuffer::matches(const UnwrapParameters& parameters, qint64 sourceKey) const
+{
+    return !m_image.isNull()
+            && m_sourceKey == sourceKey
+            && m_center == parameters.center
+            && m_innerRadius == parameters.innerRadius
+            && m_outerRadius == parameters.outerRadius
+            && m_interpolation == parameters.interpolation;
+}
+
+/**
+ * Keeps image, sampled from the source with the given cache key, with the
+ * inner circle on its first row.
+ */
+void PolarBuffer::setImage(const QImage& image, const UnwrapParameters& parameters, qint64 sourceKey)
+{
+    m_image = image;
+    m_sourceKey = sourceKey;
+    m_center = parameters.center;
+    m_innerRadius = parameters.innerRadius;
+    m_outerRadius = parameters.outerRadius;
+    m_interpolation = parameters.interpolation;
+}
+
+void PolarBuffer::clear()
+{
+    m_image = QImage();
+    m_sourceKey = 0;
+}
+
+bool PolarBuffer::isNull() const
+{
+    return m_image.isNull();
+}
+
+QImage PolarBuffer::image() const
+{
+    return m_image;
+}
+
+/**
+ * Final image of parameters: the buffer resized to the final width and
+ * scaled height, flipped when the sky is up, and centered in the fill
+ * color. Nearest neighbor unwraps are resized without smoothing.
+ */
+QImage PolarBuffer::compose(const UnwrapParameters& parameters) const
+{
+    QSize finalSize = parameters.finalSize();
+    int scaledHeight = parameters.scaledHeight();
+
+    if (m_image.isNull() || finalSize.isEmpty() || scaledHeight <= 0) {
+        return QImage();
+    }
+
+    Qt::TransformationMode mode = parameters.interpolation == Unwrapper::NoInterpolation
+            ? Qt::FastTransformation : Qt::SmoothTransformation;
+
+    QImage scaled = m_image.scaled(QSize(finalSize.width(), scaledHeight), Qt::IgnoreAspectRatio, mode);
+    if (parameters.invert) {
+        scaled = scaled.mirrored(false, true);
+    }
+
+    QImage result(finalSize, m_image.format());
+
+    QPainter p(&result);
+    p.fillRect(result.rect(), parameters.fillColor);
+    p.drawImage(QPoint(0, (finalSize.height() - scaledHeight) / 2), scaled);
+    p.end();
+
+    return result;
+}
@@ -0,0 +1,69 @@
+/******************************************************************************
+ *
+ * Copyright (c) 2010 Cláudio F. Gil <claudio.f.gil@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+#ifndef POLARBUFFER_H
+#define POLARBUFFER_H
+
+#include <QImage>
+#include <QPointF>
+
+#include "unwrapper.h"
+
+/**
+ * The mirror sampled once in polar coordinates, one column per pixel of
+ * the outer circle and one row per pixel of radius.
+ *
+ * Rows of an unwrap only depend on the radii, so once the mirror is in
+ * this buffer the field of view, focal point, final size, padding and
+ * inversion just resize and place it. Changing any of them is then a
+ * separable resize instead of sampling the whole source again. The buffer
+ * is kept until the source, the geometry or the interpolation changes.
+ *
+ * The buffer only needs the resolution of the final image, so it may be
+ * sampled from a smaller level of the source, see sourceScale().
+ */
+class PolarBuffer
+{
+public:
+    PolarBuffer();
+
+    static QSize size(const UnwrapParameters& parameters);
+    static qreal sourceScale(const UnwrapParameters& parameters);
+
+    bool matches(const UnwrapParameters& parameters, qint64 sourceKey) const;
+    void setImage(const QImage& image, const UnwrapParameters& parameters, qint64 sourceKey);
+    void clear();
+    bool isNull() const;
+
+    QImage image() const;
+    QImage compose(const UnwrapParameters& parameters) const;
+
+private:
+    QImage m_image;
+    qint64 m_sourceKey;
+    QPointF m_center;
+    qreal m_innerRadius;
+    qreal m_outerRadius;
+    Unwrapper::Interpolation m_interpolation;
+};
+
+#endif // POLARBUFFER_H
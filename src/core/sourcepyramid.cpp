@@ -0,0 +1,249 @@
+/******************************************************************************
+ *
+ * Copyright (c) 2010 Cláudio F. Gil <claudio.f.gil@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+#include <QAtomicInt>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QThread>
+
+#include "sourcepyramid.h"
+#include "unwrapper.h"
+
+/**
+ * Worker averaging bands of rows of a level into the next one, taking the
+ * next free band until none is left. It only gets the raw rows of both, as
+ * non-const QImage calls from several threads would race on detaching.
+ */
+class HalveBands : public QRunnable
+{
+public:
+    HalveBands(const uchar* sourceBits, int sourceBytesPerLine, uchar* resultBits, int resultBytesPerLine,
+               int width, int height, int bandRows, QAtomicInt* nextBand) :
+        m_sourceBits(sourceBits), m_sourceBytesPerLine(sourceBytesPerLine),
+        m_resultBits(resultBits), m_resultBytesPerLine(resultBytesPerLine),
+        m_width(width), m_height(height), m_bandRows(bandRows), m_nextBand(nextBand)
+    {
+    }
+
+    void run()
+    {
+        int height = m_height;
+        int width = m_width;
+
+        for (;;) {
+            int firstRow = m_nextBand->fetchAndAddOrdered(1) * m_bandRows;
+            if (firstRow >= height) {
+                break;
+            }
+
+            int lastRow = qMin(firstRow + m_bandRows, height);
+
+            for (int y = firstRow; y < lastRow; y++) {
+                const QRgb* line0 = (const QRgb*) (m_sourceBits + 2 * y * m_sourceBytesPerLine);
+                const QRgb* line1 = (const QRgb*) (m_sourceBits + (2 * y + 1) * m_sourceBytesPerLine);
+                QRgb* output = (QRgb*) (m_resultBits + y * m_resultBytesPerLine);
+
+                for (int x = 0; x < width; x++) {
+                    output[x] = average(line0[2 * x], line0[2 * x + 1], line1[2 * x], line1[2 * x + 1]);
+                }
+            }
+        }
+    }
+
+private:
+    const uchar* m_sourceBits;
+    int m_sourceBytesPerLine;
+    uchar* m_resultBits;
+    int m_resultBytesPerLine;
+    int m_width;
+    int m_height;
+    int m_bandRows;
+    QAtomicInt* m_nextBand;
+
+    static inline QRgb average(QRgb a, QRgb b, QRgb c, QRgb d)
+    {
+        // two channels per operation: alpha and green, red and blue
+        uint ag = ((a >> 8) & 0xff00ff) + ((b >> 8) & 0xff00ff) + ((c >> 8) & 0xff00ff) + ((d >> 8) & 0xff00ff) + 0x20002;
+        uint rb = (a & 0xff00ff) + (b & 0xff00ff) + (c & 0xff00ff) + (d & 0xff00ff) + 0x20002;
+
+        return (((ag >> 2) & 0xff00ff) << 8) | ((rb >> 2) & 0xff00ff);
+    }
+};
+
+SourcePyramid::SourcePyramid(const QImage& image)
+{
+    setImage(image);
+}
+
+QImage SourcePyramid::image() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_levels.isEmpty() ? QImage() : m_levels.first();
+}
+
+/**
+ * Replaces the image, dropping the levels of the previous one.
+ */
+void SourcePyramid::setImage(const QImage& image)
+{
+    QMutexLocker locker(&m_mutex);
+
+    m_levels.clear();
+    if (!image.isNull()) {
+        m_levels.append(image);
+    }
+}
+
+void SourcePyramid::clear()
+{
+    setImage(QImage());
+}
+
+bool SourcePyramid::isNull() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_levels.isEmpty();
+}
+
+/**
+ * Level n, building it and the ones above it if needed. Levels past the
+ * smallest one give the smallest one.
+ */
+QImage SourcePyramid::level(int n)
+{
+    QMutexLocker buildLocker(&m_buildMutex);
+
+    for (;;) {
+        QImage last;
+
+        {
+            QMutexLocker locker(&m_mutex);
+
+            if (m_levels.isEmpty()) {
+                return QImage();
+            }
+
+            n = qBound(0, n, MaxLevels - 1);
+            if (n < m_levels.size()) {
+                return m_levels.at(n);
+            }
+
+            last = m_levels.last();
+            if (last.width() < 2 || last.height() < 2) {
+                return last;
+            }
+        }
+
+        QImage half = halve(last);
+
+        QMutexLocker locker(&m_mutex);
+
+        // dropped if the image was replaced while halving
+        if (!m_levels.isEmpty() && m_levels.last().cacheKey() == last.cacheKey()) {
+            m_levels.append(half);
+        }
+    }
+}
+
+/**
+ * The level closest to n among those already built, without building any.
+ * Its number goes to built: n if it is built, otherwise the smallest level
+ * built so far, which has more resolution than n.
+ */
+QImage SourcePyramid::builtLevel(int n, int& built) const
+{
+    QMutexLocker locker(&m_mutex);
+
+    if (m_levels.isEmpty()) {
+        built = 0;
+        return QImage();
+    }
+
+    built = qBound(0, n, m_levels.size() - 1);
+    return m_levels.at(built);
+}
+
+/**
+ * Smallest level that still has scale times the resolution of the image,
+ * and that the image is large enough to have.
+ */
+int SourcePyramid::levelFor(qreal scale) const
+{
+    QMutexLocker locker(&m_mutex);
+
+    QSize size = m_levels.isEmpty() ? QSize() : m_levels.first().size();
+
+    int n = 0;
+    while (n + 1 < MaxLevels && levelScale(n + 1) >= scale
+           && (size.width() >> (n + 1)) > 0 && (size.height() >> (n + 1)) > 0) {
+        n++;
+    }
+
+    return n;
+}
+
+/**
+ * Size of level n relative to the image.
+ */
+qreal SourcePyramid::levelScale(int n)
+{
+    return 1.0 / (1 << n);
+}
+
+/**
+ * Averages image down to half its size, in 32 bits, spreading the rows
+ * over the pool.
+ */
+QImage SourcePyramid::halve(const QImage& image)
+{
+    QImage source = image;
+    QImage::Format format = Unwrapper::outputFormat(image);
+    if (source.format() != format) {
+        source = source.convertToFormat(format);
+    }
+
+    QImage result(source.width() / 2, source.height() / 2, format);
+
+    int bandRows = qMax(1, 16384 / result.width());
+    int bands = (result.height() + bandRows - 1) / bandRows;
+    int threads = qMin(qMax(1, QThread::idealThreadCount()), bands);
+
+    // detached here, once, before any worker touches the pixels
+    const uchar* sourceBits = source.constBits();
+    int sourceBytesPerLine = source.bytesPerLine();
+    uchar* resultBits = result.bits();
+    int resultBytesPerLine = result.bytesPerLine();
+
+    QAtomicInt nextBand(0);
+    m_pool.setMaxThreadCount(threads);
+
+    for (int i = 1; i < threads; i++) {
+        m_pool.start(new HalveBands(sourceBits, sourceBytesPerLine, resultBits, resultBytesPerLine,
+                                    result.width(), result.height(), bandRows, &nextBand));
+    }
+
+    HalveBands(sourceBits, sourceBytesPerLine, resultBits, resultBytesPerLine,
+               result.width(), result.height(), bandRows, &nextBand).run();
+    m_pool.waitForDone();
+
+    return result;
+}
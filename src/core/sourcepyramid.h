@@ -0,0 +1,71 @@
+/******************************************************************************
+ *
+ * Copyright (c) 2010 Cláudio F. Gil <claudio.f.gil@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+#ifndef SOURCEPYRAMID_H
+#define SOURCEPYRAMID_H
+
+#include <QImage>
+#include <QMutex>
+#include <QThreadPool>
+#include <QVector>
+
+/**
+ * A source image together with its half resolution levels, each built the
+ * first time it is asked for and kept until the image changes.
+ *
+ * Level 0 is the image itself and every next level averages 2x2 pixels of
+ * the previous one. Unwraps that need less than the full resolution read a
+ * smaller level, which is faster and aliases less. Levels may be asked for
+ * from any thread. They are built one at a time and outside the lock on the
+ * levels, so builtLevel() and setImage() never wait for a build.
+ */
+class SourcePyramid
+{
+public:
+    explicit SourcePyramid(const QImage& image = QImage());
+
+    enum {
+        MaxLevels = 8
+    };
+
+    QImage image() const;
+    void setImage(const QImage& image);
+    void clear();
+    bool isNull() const;
+
+    QImage level(int n);
+    QImage builtLevel(int n, int& built) const;
+    int levelFor(qreal scale) const;
+    static qreal levelScale(int n);
+
+private:
+    mutable QMutex m_mutex;
+    QMutex m_buildMutex;
+    QVector<QImage> m_levels;
+    QThreadPool m_pool;
+
+    QImage halve(const QImage& image);
+
+    Q_DISABLE_COPY(SourcePyramid)
+};
+
+#endif // SOURCEPYRAMID_H
@@ -0,0 +1,102 @@
+/******************************************************************************
+ *
+ * Copyright (c) 2010 Cláudio F. Gil <claudio.f.gil@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+#include <qmath.h>
+
+#include "sourcereader.h"
+
+SourceReader::SourceReader(const QString& path) :
+    m_reader(path)
+{
+}
+
+/**
+ * Size of the whole image, read from its header.
+ */
+QSize SourceReader::size()
+{
+    return m_reader.size();
+}
+
+/**
+ * Decodes the part of the image the mirror of parameters covers into
+ * image and moves the center and radii of parameters to it.
+ */
+bool SourceReader::read(UnwrapParameters& parameters, QImage& image, bool downscale)
+{
+    QSize imageSize = m_reader.size();
+    if (!imageSize.isValid()) {
+        m_errorString = m_reader.errorString();
+        return false;
+    }
+
+    QRect rect = annulusRect(parameters.center, parameters.outerRadius, imageSize);
+    if (rect.isEmpty()) {
+        m_errorString = "the mirror is outside the image";
+        return false;
+    }
+
+    qreal scale = downscale ? parameters.sourceScale() : 1;
+
+    if (rect != QRect(QPoint(0, 0), imageSize)) {
+        m_reader.setClipRect(rect);
+    }
+
+    if (scale < 1) {
+        QSize scaledSize(qMax(1, qCeil(rect.width() * scale)), qMax(1, qCeil(rect.height() * scale)));
+        m_reader.setScaledSize(scaledSize);
+
+        // the rounded size is the real scale
+        scale = qreal(scaledSize.width()) / rect.width();
+    }
+    else {
+        scale = 1;
+    }
+
+    if (!m_reader.read(&image)) {
+        m_errorString = m_reader.errorString();
+        return false;
+    }
+
+    parameters = parameters.mapped(rect.topLeft(), scale);
+
+    return true;
+}
+
+QString SourceReader::errorString() const
+{
+    return m_errorString;
+}
+
+/**
+ * Square around the outer circle, with the two extra pixels the bicubic
+ * kernel reads, within the image.
+ */
+QRect SourceReader::annulusRect(const QPointF& center, qreal outerRadius, const QSize& imageSize)
+{
+    int left = qFloor(center.x() - outerRadius) - 2;
+    int top = qFloor(center.y() - outerRadius) - 2;
+    int right = qCeil(center.x() + outerRadius) + 3;
+    int bottom = qCeil(center.y() + outerRadius) + 3;
+
+    return QRect(QPoint(left, top), QPoint(right, bottom)) & QRect(QPoint(0, 0), imageSize);
+}
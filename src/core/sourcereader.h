@@ -0,0 +1,59 @@
+/******************************************************************************
+ *
+ * Copyright (c) 2010 Cláudio F. Gil <claudio.f.gil@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+#ifndef SOURCEREADER_H
+#define SOURCEREADER_H
+
+#include <QImage>
+#include <QImageReader>
+#include <QRect>
+#include <QString>
+
+#include "unwrapper.h"
+
+/**
+ * Loads a source image for unwrapping, decoding only the square around the
+ * mirror. The geometry of the parameters is moved to the decoded image.
+ *
+ * When the mirror is sampled at the final size, that size alone decides
+ * how much of the source is needed, so the decoder may also scale the
+ * image down; JPEG files are then scaled while decoding, at a fraction of
+ * the cost of a full decode.
+ */
+class SourceReader
+{
+public:
+    explicit SourceReader(const QString& path);
+
+    QSize size();
+    bool read(UnwrapParameters& parameters, QImage& image, bool downscale = true);
+
+    QString errorString() const;
+
+    static QRect annulusRect(const QPointF& center, qreal outerRadius, const QSize& imageSize);
+
+private:
+    QImageReader m_reader;
+    QString m_errorString;
+};
+
+#endif // SOURCEREADER_H
@@ -0,0 +1,363 @@
+/******************************************************************************
+ *
+ * Copyright (c) 2010 Cláudio F. Gil <claudio.f.gil@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+
+#include <QFile>
+#include <qmath.h>
+
+#include <limits.h>
+
+#include "unwrapmap.h"
+
+/**
+ * Start of a saved map, followed by the coordinates and the bounds of the
+ * tiles. The magic number also tells the byte order apart.
+ */
+struct MapFileHeader
+{
+    quint32 magic;
+    quint32 version;
+    qint32 width;
+    qint32 height;
+    double centerX;
+    double centerY;
+    double innerRadius;
+    double outerRadius;
+    quint32 invert;
+    quint32 reserved;
+};
+
+static const quint32 MapFileMagic = 0x55333630; // "U360"
+
+UnwrapMap::UnwrapMap() :
+    m_innerRadius(0), m_outerRadius(0),
+    m_width(0), m_height(0),
+    m_firstRow(0), m_rowCount(0),
+    m_invert(false),
+    m_points(0)
+{
+}
+
+void UnwrapMap::build(const QPointF& center, qreal innerRadius, qreal outerRadius,
+                      int width, int height, bool invert)
+{
+    buildRows(center, innerRadius, outerRadius, width, height, invert, 0, height);
+}
+
+/**
+ * Builds only rows firstRow to firstRow + rowCount of the map of the given
+ * size. The angle tables are kept when the width doesn't change, so moving
+ * a band down the image only costs the coordinates.
+ */
+void UnwrapMap::buildRows(const QPointF& center, qreal innerRadius, qreal outerRadius,
+                          int width, int height, bool invert, int firstRow, int rowCount)
+{
+    rowCount = qMin(rowCount, height - firstRow);
+    if (width <= 0 || height <= 0 || firstRow < 0 || rowCount <= 0) {
+        clear();
+        return;
+    }
+
+    m_center = center;
+    m_innerRadius = innerRadius;
+    m_outerRadius = outerRadius;
+    m_height = height;
+    m_firstRow = firstRow;
+    m_rowCount = rowCount;
+    m_invert = invert;
+
+    if (m_width != width || m_cos.size() != width) {
+        m_width = width;
+        buildAngleTables();
+    }
+
+    m_file.clear();
+    m_coordinates.resize(2 * width * rowCount);
+    qint32* coordinates = m_coordinates.data();
+    m_points = coordinates;
+
+    const qreal* cosines = m_cos.constData();
+    const qreal* sines = m_sin.constData();
+
+    qreal cx = center.x() * FractionOne;
+    qreal cy = center.y() * FractionOne;
+
+    for (int y = firstRow; y < firstRow + rowCount; y++) {
+        int usedY = invert ? height - (y + 1) : y;
+        qreal ro = innerRadius + ((usedY * (outerRadius - innerRadius)) / height);
+        ro *= FractionOne;
+
+        for (int x = 0; x < width; x++) {
+            *coordinates++ = qRound(cx + ro * cosines[x]);
+            *coordinates++ = qRound(cy + ro * sines[x]);
+        }
+    }
+
+    buildTileBounds();
+}
+
+/**
+ * One sine and cosine per column, which is all the trigonometry needed.
+ * The angle runs clockwise because mirrors reflect.
+ */
+void UnwrapMap::buildAngleTables()
+{
+    m_cos.resize(m_width);
+    m_sin.resize(m_width);
+
+    for (int x = 0; x < m_width; x++) {
+        qreal ang = (2 * M_PI * x) / m_width;
+
+        m_cos[x] = qCos(ang);
+        m_sin[x] = -qSin(ang);
+    }
+}
+
+/**
+ * Finds the source pixels the points of every tile fall in.
+ */
+void UnwrapMap::buildTileBounds()
+{
+    int columns = tileColumns();
+    int tileRows = (m_rowCount + TileRows - 1) / TileRows;
+
+    m_tileBounds.resize(4 * columns * tileRows);
+    qint32* bounds = m_tileBounds.data();
+
+    for (int ty = 0; ty < tileRows; ty++) {
+        int firstY = ty * TileRows;
+        int lastY = qMin(firstY + TileRows, m_rowCount);
+
+        for (int tx = 0; tx < columns; tx++) {
+            int firstX = tx * TileWidth;
+            int lastX = qMin(firstX + TileWidth, m_width);
+
+            qint32 left = INT_MAX;
+            qint32 top = INT_MAX;
+            qint32 right = INT_MIN;
+            qint32 bottom = INT_MIN;
+
+            for (int y = firstY; y < lastY; y++) {
+                const qint32* p = row(y) + 2 * firstX;
+
+                for (int x = firstX; x < lastX; x++) {
+                    left = qMin(left, p[0]);
+                    right = qMax(right, p[0]);
+                    top = qMin(top, p[1]);
+                    bottom = qMax(bottom, p[1]);
+                    p += 2;
+                }
+            }
+
+            *bounds++ = left >> FractionBits;
+            *bounds++ = top >> FractionBits;
+            *bounds++ = right >> FractionBits;
+            *bounds++ = bottom >> FractionBits;
+        }
+    }
+}
+
+int UnwrapMap::tileColumns() const
+{
+    return (m_width + TileWidth - 1) / TileWidth;
+}
+
+bool UnwrapMap::matches(const QPointF& center, qreal innerRadius, qreal outerRadius,
+                        int width, int height, bool invert) const
+{
+    return !isNull()
+            && m_center == center
+            && m_innerRadius == innerRadius
+            && m_outerRadius == outerRadius
+            && m_width == width
+            && m_height == height
+            && m_invert == invert
+            && m_firstRow == 0
+            && m_rowCount == height;
+}
+
+void UnwrapMap::clear()
+{
+    m_width = 0;
+    m_height = 0;
+    m_firstRow = 0;
+    m_rowCount = 0;
+
+    m_cos.clear();
+    m_sin.clear();
+    m_coordinates.clear();
+    m_points = 0;
+    m_file.clear();
+    m_tileBounds.clear();
+}
+
+bool UnwrapMap::isNull() const
+{
+    return m_points == 0;
+}
+
+/**
+ * Writes a whole map to path. Bands are not saved.
+ */
+bool UnwrapMap::save(const QString& path) const
+{
+    if (isNull() || m_firstRow != 0 || m_rowCount != m_height) {
+        return false;
+    }
+
+    MapFileHeader header;
+    header.magic = MapFileMagic;
+    header.version = FileVersion;
+    header.width = m_width;
+    header.height = m_height;
+    header.centerX = m_center.x();
+    header.centerY = m_center.y();
+    header.innerRadius = m_innerRadius;
+    header.outerRadius = m_outerRadius;
+    header.invert = m_invert;
+    header.reserved = 0;
+
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+
+    qint64 size = qint64(2 * sizeof(qint32)) * m_width * m_height;
+    qint64 boundsSize = m_tileBounds.size() * sizeof(qint32);
+    bool ok = file.write((const char*) &header, sizeof(header)) == sizeof(header)
+            && file.write((const char*) m_points, size) == size
+            && file.write((const char*) m_tileBounds.constData(), boundsSize) == boundsSize;
+    file.close();
+
+    if (!ok) {
+        file.remove();
+    }
+
+    return ok;
+}
+
+/**
+ * Maps a map saved by save() in memory. Fails on files of another version
+ * or byte order, leaving the map as it was.
+ */
+bool UnwrapMap::load(const QString& path)
+{
+    QSharedPointer<QFile> file(new QFile(path));
+    if (!file->open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    MapFileHeader header;
+    if (file->read((char*) &header, sizeof(header)) != sizeof(header)
+            || header.magic != MapFileMagic || header.version != FileVersion
+            || header.width <= 0 || header.height <= 0) {
+        return false;
+    }
+
+    int tiles = ((header.width + TileWidth - 1) / TileWidth) * ((header.height + TileRows - 1) / TileRows);
+    QVector<qint32> tileBounds(4 * tiles);
+    qint64 boundsSize = tileBounds.size() * sizeof(qint32);
+
+    qint64 size = qint64(2 * sizeof(qint32)) * header.width * header.height;
+    if (file->size() != qint64(sizeof(header)) + size + boundsSize) {
+        return false;
+    }
+
+    uchar* points = file->map(sizeof(header), size);
+    if (!points) {
+        return false;
+    }
+
+    // the bounds are small, they are read
+    file->seek(sizeof(header) + size);
+    if (file->read((char*) tileBounds.data(), boundsSize) != boundsSize) {
+        return false;
+    }
+
+    m_center = QPointF(header.centerX, header.centerY);
+    m_innerRadius = header.innerRadius;
+    m_outerRadius = header.outerRadius;
+    m_width = header.width;
+    m_height = header.height;
+    m_firstRow = 0;
+    m_rowCount = header.height;
+    m_invert = header.invert;
+
+    // the angle tables are only needed to build
+    m_cos.clear();
+    m_sin.clear();
+    m_coordinates.clear();
+
+    m_file = file;
+    m_points = (const qint32*) points;
+    m_tileBounds = tileBounds;
+
+    return true;
+}
+
+int UnwrapMap::width() const
+{
+    return m_width;
+}
+
+/**
+ * Number of rows held, which is less than the height given to buildRows()
+ * for a band.
+ */
+int UnwrapMap::height() const
+{
+    return m_rowCount;
+}
+
+int UnwrapMap::firstRow() const
+{
+    return m_firstRow;
+}
+
+/**
+ * Source pixels that hold the integer part of the points of the given
+ * columns and rows, counted from firstRow(). The bounds of whole tiles are
+ * used, so the result may be somewhat larger.
+ */
+QRect UnwrapMap::sourceBounds(int x, int y, int width, int height) const
+{
+    if (m_tileBounds.isEmpty() || width <= 0 || height <= 0) {
+        return QRect();
+    }
+
+    int columns = tileColumns();
+    int firstTileX = qMax(0, x / TileWidth);
+    int lastTileX = qMin(columns - 1, (x + width - 1) / TileWidth);
+    int firstTileY = qMax(0, y / TileRows);
+    int lastTileY = qMin((m_rowCount - 1) / TileRows, (y + height - 1) / TileRows);
+
+    QRect bounds;
+
+    for (int ty = firstTileY; ty <= lastTileY; ty++) {
+        for (int tx = firstTileX; tx <= lastTileX; tx++) {
+            const qint32* b = m_tileBounds.constData() + 4 * (ty * columns + tx);
+            bounds |= QRect(QPoint(b[0], b[1]), QPoint(b[2], b[3]));
+        }
+    }
+
+    return bounds;
+}
@@ -0,0 +1,134 @@
+/******************************************************************************
+ *
+ * Copyright (c) 2010 Cláudio F. Gil <claudio.f.gil@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+
+#ifndef UNWRAPMAP_H
+#define UNWRAPMAP_H
+
+#include <QPointF>
+#include <QRect>
+#include <QVector>
+#include <QSharedPointer>
+#include <QString>
+
+class QFile;
+
+/**
+ * Precomputed table of source coordinates for every pixel of the unwrapped
+ * image.
+ *
+ * The table only depends on the geometry of the mirror (center and radii),
+ * on the size of the unwrapped image and on the inversion flag, so it can be
+ * built once and reused for every image taken with the same rig. Coordinates
+ * are stored as 16.16 fixed point pairs (x, y) row by row.
+ *
+ * A map may also hold only a band of the rows, so that very large images
+ * can be sampled without the whole table in memory.
+ *
+ * Whole maps can be saved to a file and loaded back, the coordinates being
+ * mapped in memory rather than read. See MapCache.
+ *
+ * The source pixels the points of each tile of TileRows by TileWidth fall
+ * in are kept with the map, so that samplers can tell the tiles that stay
+ * inside a source from those reaching its border without looking at every
+ * point.
+ */
+class UnwrapMap
+{
+public:
+    UnwrapMap();
+
+    enum {
+        FractionBits = 16,
+        FractionOne = 1 << FractionBits,
+        FractionMask = FractionOne - 1
+    };
+
+    enum {
+        FileVersion = 2
+    };
+
+    enum {
+        TileWidth = 128,
+        TileRows = 64
+    };
+
+    void build(const QPointF& center, qreal innerRadius, qreal outerRadius,
+               int width, int height, bool invert);
+    void buildRows(const QPointF& center, qreal innerRadius, qreal outerRadius,
+                   int width, int height, bool invert, int firstRow, int rowCount);
+
+    bool matches(const QPointF& center, qreal innerRadius, qreal outerRadius,
+                 int width, int height, bool invert) const;
+
+    void clear();
+    bool isNull() const;
+
+    bool save(const QString& path) const;
+    bool load(const QString& path);
+
+    int width() const;
+    int height() const;
+    int firstRow() const;
+
+    QRect sourceBounds(int x, int y, int width, int height) const;
+
+    /**
+     * Fixed point (x, y) pairs for all the pixels of row y, counted from
+     * firstRow().
+     */
+    inline const qint32* row(int y) const {
+        return m_points + 2 * y * m_width;
+    }
+
+    inline QPointF point(int x, int y) const {
+        const qint32* p = row(y) + 2 * x;
+        return QPointF(p[0] / qreal(FractionOne), p[1] / qreal(FractionOne));
+    }
+
+private:
+    QPointF m_center;
+    qreal m_innerRadius;
+    qreal m_outerRadius;
+    int m_width;
+    int m_height;
+    int m_firstRow;
+    int m_rowCount;
+    bool m_invert;
+
+    QVector<qreal> m_cos;
+    QVector<qreal> m_sin;
+    QVector<qint32> m_coordinates;
+
+    // the coordinates, in m_coordinates or in the mapped file
+    const qint32* m_points;
+    QSharedPointer<QFile> m_file;
+
+    // left, top, right and bottom source pixel of each tile, row by row
+    QVector<qint32> m_tileBounds;
+
+    void buildAngleTables();
+    void buildTileBounds();
+    int tileColumns() const;
+};
+
+#endif // UNWRAPMAP_H
@@ -0,0 +1,799 @@
+/******************************************************************************
+ *
+ * Copyright (c) 2010 Cláudio F. Gil <claudio.f.gil@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+
+#include <QRunnable>
+#include <QThread>
+#include <QPainter>
+#include <QtAlgorithms>
+#include <qmath.h>
+
+#include "unwrapper.h"
+#include "unwrapmap.h"
+#include "interpolation.h"
+#include "unwrapsink.h"
+#include "sourcepyramid.h"
+#include "mapcache.h"
+#include "polarbuffer.h"
+
+/**
+ * Worker that keeps taking the next free band of rows until none is left,
+ * so faster threads naturally pick up the work of slower ones.
+ */
+class SampleBands : public QRunnable
+{
+public:
+    SampleBands(Unwrapper* unwrapper, const SourcePixels* source, const UnwrapMap* map, const SamplerKernels* kernels,
+                QRgb* outputPixels, int outputStride, int bandRows, QAtomicInt* nextBand) :
+        m_unwrapper(unwrapper), m_source(source), m_map(map), m_kernels(kernels),
+        m_outputPixels(outputPixels), m_outputStride(outputStride), m_bandRows(bandRows), m_nextBand(nextBand)
+    {
+    }
+
+    void run()
+    {
+        int height = m_map->height();
+
+        for (;;) {
+            int firstRow = m_nextBand->fetchAndAddOrdered(1) * m_bandRows;
+            if (firstRow >= height || m_unwrapper->isCanceled()) {
+                break;
+            }
+
+            int lastRow = qMin(firstRow + m_bandRows, height) - 1;
+            m_unwrapper->sampleRows(*m_source, *m_map, *m_kernels,
+                                    m_outputPixels, m_outputStride, firstRow, lastRow);
+        }
+    }
+
+private:
+    Unwrapper* m_unwrapper;
+    const SourcePixels* m_source;
+    const UnwrapMap* m_map;
+    const SamplerKernels* m_kernels;
+    QRgb* m_outputPixels;
+    int m_outputStride;
+    int m_bandRows;
+    QAtomicInt* m_nextBand;
+};
+
+UnwrapParameters::UnwrapParameters() :
+    innerRadius(0),
+    outerRadius(0),
+    fov(120),
+    focalPointPercent(35),
+    interpolation(Unwrapper::BilinearInterpolation),
+    invert(true),
+    finalWidth(3000),
+    finalHeight(0),
+    equiRectangular(true),
+    fillColor(Qt::black),
+    singlePass(false),
+    threadCount(0)
+{
+}
+
+QSize UnwrapParameters::unwrappedSize() const
+{
+    return Unwrapper::unwrappedSize(innerRadius, outerRadius, focalPointPercent, fov);
+}
+
+/**
+ * A finalHeight of zero means it follows from finalWidth.
+ */
+QSize UnwrapParameters::finalSize() const
+{
+    int height = finalHeight > 0 ? finalHeight : Unwrapper::finalHeight(finalWidth, fov, equiRectangular);
+    return QSize(finalWidth, height);
+}
+
+int UnwrapParameters::scaledHeight() const
+{
+    return Unwrapper::scaledHeight(finalSize().height(), fov, equiRectangular);
+}
+
+/**
+ * Whether the mirror is sampled straight at the final size, either asked
+ * for or because the sampler, like area averaging, already filters at that
+ * resolution.
+ */
+bool UnwrapParameters::samplesFinalSize() const
+{
+    const Sampler* sampler = findSampler(interpolation);
+    return singlePass || (sampler && sampler->footprintRow);
+}
+
+/**
+ * Size at which the mirror is sampled. In a single pass it is the part of
+ * the final image the mirror covers, so nothing has to be resized after.
+ */
+QSize UnwrapParameters::mapSize() const
+{
+    if (samplesFinalSize()) {
+        return QSize(finalWidth, scaledHeight());
+    }
+
+    return unwrappedSize();
+}
+
+/**
+ * Fraction of the source resolution the final image needs: the densest
+ * sampling is either around the outer circle or along a radius. It is one
+ * unless sampling straight at the final size, as otherwise the sampled size
+ * itself depends on the radii.
+ */
+qreal UnwrapParameters::sourceScale() const
+{
+    qreal ring = outerRadius - innerRadius;
+    if (!samplesFinalSize() || outerRadius <= 0 || ring <= 0) {
+        return 1;
+    }
+
+    QSize size = mapSize();
+    qreal around = size.width() / (2 * M_PI * outerRadius);
+    qreal along = size.height() / ring;
+
+    return qMin(qreal(1), qMax(around, along));
+}
+
+/**
+ * The same unwrap of a source whose pixels are those of this one from
+ * origin on, resized by scale. Pixel centers map to pixel centers.
+ */
+UnwrapParameters UnwrapParameters::mapped(const QPointF& origin, qreal scale) const
+{
+    UnwrapParameters p = *this;
+    p.center = QPointF((center.x() - origin.x() + 0.5) * scale - 0.5,
+                       (center.y() - origin.y() + 0.5) * scale - 0.5);
+    p.innerRadius = innerRadius * scale;
+    p.outerRadius = outerRadius * scale;
+
+    return p;
+}
+
+Unwrapper::Unwrapper(QObject *parent) :
+    QObject(parent),
+    m_parameters(new UnwrapParameters()),
+    m_mapCache(0),
+    m_polarBuffer(0),
+    m_canceled(0),
+    m_progressRows(0)
+{
+}
+
+Unwrapper::~Unwrapper()
+{
+    delete m_parameters;
+}
+
+const UnwrapParameters& Unwrapper::parameters() const
+{
+    return *m_parameters;
+}
+
+void Unwrapper::setParameters(const UnwrapParameters& parameters)
+{
+    *m_parameters = parameters;
+}
+
+/**
+ * Number of threads used for sampling. A threadCount of zero in the
+ * parameters means one per core.
+ */
+int Unwrapper::threadCount() const
+{
+    return m_parameters->threadCount > 0 ? m_parameters->threadCount : QThread::idealThreadCount();
+}
+
+MapCache* Unwrapper::mapCache() const
+{
+    return m_mapCache;
+}
+
+/**
+ * Cache whole maps are taken from and saved to, or 0 to always build them.
+ * It is not owned.
+ */
+void Unwrapper::setMapCache(MapCache* cache)
+{
+    m_mapCache = cache;
+}
+
+PolarBuffer* Unwrapper::polarBuffer() const
+{
+    return m_polarBuffer;
+}
+
+/**
+ * Buffer the mirror is sampled into by unwrap(SourcePyramid*) and resized
+ * from while the geometry stays the same, or 0 to sample it every time.
+ * It is not owned.
+ */
+void Unwrapper::setPolarBuffer(PolarBuffer* buffer)
+{
+    m_polarBuffer = buffer;
+}
+
+bool Unwrapper::isCanceled() const
+{
+    return m_canceled != 0;
+}
+
+/**
+ * Cancellation is sticky: it must be cleared before starting a new unwrap.
+ */
+void Unwrapper::setCanceled(bool canceled)
+{
+    m_canceled = canceled ? 1 : 0;
+}
+
+void Unwrapper::cancel()
+{
+    setCanceled(true);
+}
+
+/**
+ * Size of the image sampled from the mirror. Its width is the circumference
+ * of the circle at focalPointPercent between the inner and outer radius, so
+ * that circle keeps its resolution, and its height covers fov degrees.
+ */
+QSize Unwrapper::unwrappedSize(qreal innerRadius, qreal outerRadius, int focalPointPercent, int fov)
+{
+    qreal focalRadius = innerRadius + ((focalPointPercent / 100.0) * (outerRadius - innerRadius));
+    int width = 2 * focalRadius * M_PI;
+    int height = (width * fov) / 360; // width = 360 deg
+
+    return QSize(width, height);
+}
+
+/**
+ * Height of a final image finalWidth wide. Equirectangular images always
+ * cover 180 degrees vertically.
+ */
+int Unwrapper::finalHeight(int finalWidth, int fov, bool equiRectangular)
+{
+    int f = equiRectangular ? 180 : fov;
+    return (finalWidth * f) / 360;
+}
+
+/**
+ * Height taken by the unwrapped image inside a final image finalHeight
+ * high. Equirectangular images are padded to cover 180 degrees.
+ */
+int Unwrapper::scaledHeight(int finalHeight, int fov, bool equiRectangular)
+{
+    qreal factor = ((float) (equiRectangular ? fov : 180)) / 180.0;
+    return finalHeight * factor;
+}
+
+/**
+ * Unwraps source with the current parameters. The map is rebuilt only if
+ * the geometry or the sampled size changed since the last call. Returns
+ * a null image if canceled.
+ */
+QImage Unwrapper::unwrap(const QImage& source)
+{
+    updateMap(*m_parameters);
+    return unwrap(source, m_map);
+}
+
+/**
+ * Unwraps source through a map built elsewhere, e.g. shared by several
+ * unwrappers. Only the sampling and final size parameters are used.
+ */
+QImage Unwrapper::unwrap(const QImage& source, const UnwrapMap& map)
+{
+    if (source.isNull() || map.isNull()) {
+        return QImage();
+    }
+
+    QImage converted;
+    SourcePixels pixels = sourcePixels(source, converted);
+
+    QImage result = QImage(m_parameters->finalSize(), outputFormat(source));
+    if (!unwrapInto(pixels, map, result)) {
+        return QImage();
+    }
+
+    return result;
+}
+
+/**
+ * Unwraps an image in memory owned by the caller, without copying it.
+ */
+QImage Unwrapper::unwrap(const uchar* sourceBits, int width, int height, int bytesPerLine, QImage::Format format)
+{
+    return unwrap(QImage(sourceBits, width, height, bytesPerLine, format));
+}
+
+/**
+ * Unwraps an image in memory owned by the caller into another buffer of
+ * the caller, which must hold a 32 bit image of parameters().finalSize()
+ * in outputFormat(). Returns false if canceled or nothing was unwrapped.
+ */
+bool Unwrapper::unwrap(const uchar* sourceBits, int width, int height, int bytesPerLine, QImage::Format format,
+                       uchar* outputBits, int outputBytesPerLine)
+{
+    updateMap(*m_parameters);
+
+    QImage source(sourceBits, width, height, bytesPerLine, format);
+    if (source.isNull() || m_map.isNull()) {
+        return false;
+    }
+
+    QImage converted;
+    SourcePixels pixels = sourcePixels(source, converted);
+
+    QSize finalSize = m_parameters->finalSize();
+    QImage result(outputBits, finalSize.width(), finalSize.height(), outputBytesPerLine, outputFormat(source));
+
+    return unwrapInto(pixels, m_map, result);
+}
+
+/**
+ * Unwraps pixels in a layout QImage can't hold, such as 16 bits per
+ * channel, straight from the buffer of the caller. The result is ARGB32
+ * if the alpha flag of the source is set, RGB32 otherwise.
+ */
+QImage Unwrapper::unwrap(const SourcePixels& source)
+{
+    updateMap(*m_parameters);
+
+    if (!source.bits || m_map.isNull()) {
+        return QImage();
+    }
+
+    QImage result = QImage(m_parameters->finalSize(), source.alpha ? QImage::Format_ARGB32 : QImage::Format_RGB32);
+    if (!unwrapInto(source, m_map, result)) {
+        return QImage();
+    }
+
+    return result;
+}
+
+/**
+ * Unwraps the smallest level of pyramid that still has the resolution the
+ * final image needs, see UnwrapParameters::sourceScale(). The map is kept
+ * for that level as for a plain source.
+ *
+ * With a polar buffer, and unless the sampler works at the final size, the
+ * level the buffer needs is sampled into it instead, see
+ * PolarBuffer::sourceScale(), and only resized when just the output
+ * settings changed.
+ */
+QImage Unwrapper::unwrap(SourcePyramid* pyramid)
+{
+    if (m_polarBuffer && !m_parameters->samplesFinalSize()) {
+        int level = pyramid->levelFor(PolarBuffer::sourceScale(*m_parameters));
+        UnwrapParameters p = level == 0
+                ? *m_parameters : m_parameters->mapped(QPointF(0, 0), SourcePyramid::levelScale(level));
+
+        QImage source = pyramid->level(level);
+        if (!m_polarBuffer->matches(p, source.cacheKey()) && !samplePolar(source, p)) {
+            return QImage();
+        }
+
+        QImage result = m_polarBuffer->compose(p);
+        emit progressChanged(100);
+
+        return result;
+    }
+
+    int level = pyramid->levelFor(m_parameters->sourceScale());
+    if (level == 0) {
+        return unwrap(pyramid->image());
+    }
+
+    updateMap(m_parameters->mapped(QPointF(0, 0), SourcePyramid::levelScale(level)));
+    return unwrap(pyramid->level(level), m_map);
+}
+
+/**
+ * Format of the images unwrapped from source. 32 bit sources keep theirs,
+ * others give RGB32, or ARGB32 if they have an alpha channel.
+ */
+QImage::Format Unwrapper::outputFormat(const QImage& source)
+{
+    switch (source.format()) {
+    case QImage::Format_RGB32:
+    case QImage::Format_ARGB32:
+    case QImage::Format_ARGB32_Premultiplied:
+        return source.format();
+    default:
+        return source.hasAlphaChannel() ? QImage::Format_ARGB32 : QImage::Format_RGB32;
+    }
+}
+
+/**
+ * The pixels of image as the kernels read them. Formats without a kernel
+ * are converted to 32 bits into converted, which must outlive the result.
+ */
+SourcePixels Unwrapper::sourcePixels(const QImage& image, QImage& converted)
+{
+    SourcePixels pixels;
+    pixels.bits = image.bits();
+    pixels.width = image.width();
+    pixels.height = image.height();
+    pixels.bytesPerLine = image.bytesPerLine();
+    pixels.alpha = image.hasAlphaChannel();
+
+    switch (image.format()) {
+    case QImage::Format_RGB32:
+    case QImage::Format_ARGB32:
+    case QImage::Format_ARGB32_Premultiplied:
+        pixels.format = SourceRgb32;
+        return pixels;
+    case QImage::Format_RGB888:
+        pixels.format = SourceRgb888;
+        return pixels;
+    case QImage::Format_Indexed8:
+        // indices past the table read transparent black
+        m_colorTable = image.colorTable();
+        m_colorTable.resize(256);
+
+        pixels.format = SourceIndexed8;
+        pixels.colorTable = m_colorTable.constData();
+        return pixels;
+#if QT_VERSION >= 0x050500
+    case QImage::Format_Grayscale8:
+        pixels.format = SourceGray8;
+        return pixels;
+#endif
+#if QT_VERSION >= 0x050c00
+    case QImage::Format_RGBA64:
+    case QImage::Format_RGBX64:
+        pixels.format = SourceRgba64;
+        return pixels;
+#endif
+    default:
+        break;
+    }
+
+    converted = image.convertToFormat(outputFormat(image));
+    return sourcePixels(converted, converted);
+}
+
+/**
+ * Rebuilds the map if it no longer matches p, or takes it from the map
+ * cache.
+ */
+void Unwrapper::updateMap(const UnwrapParameters& p)
+{
+    QSize size = p.mapSize();
+
+    if (m_map.matches(p.center, p.innerRadius, p.outerRadius, size.width(), size.height(), p.invert)) {
+        return;
+    }
+
+    if (m_mapCache) {
+        m_map = m_mapCache->map(p);
+    }
+    else {
+        m_map.build(p.center, p.innerRadius, p.outerRadius, size.width(), size.height(), p.invert);
+    }
+}
+
+/**
+ * Samples the mirror of p in source into the polar buffer. The map comes
+ * from the map cache if there is one, otherwise it is built in bands so
+ * that only a band of it is in memory. Returns false if canceled.
+ */
+bool Unwrapper::samplePolar(const QImage& source, const UnwrapParameters& p)
+{
+    QSize size = PolarBuffer::size(p);
+
+    if (source.isNull() || size.isEmpty()) {
+        return false;
+    }
+
+    QImage converted;
+    SourcePixels pixels = sourcePixels(source, converted);
+
+    QImage polar(size, outputFormat(source));
+    int stride = polar.bytesPerLine() / sizeof(QRgb);
+    UnwrapMap map;
+    SamplerKernels kernels(findSampler(p.interpolation), pixels.format);
+
+    startProgress(size.height());
+
+    if (m_mapCache) {
+        map = m_mapCache->map(p.center, p.innerRadius, p.outerRadius, size, false);
+        sampleBands(pixels, map, kernels, (QRgb*) polar.bits(), stride);
+    }
+    else {
+        for (int y = 0; y < size.height() && !isCanceled(); y += StreamBandRows) {
+            map.buildRows(p.center, p.innerRadius, p.outerRadius, size.width(), size.height(), false,
+                          y, StreamBandRows);
+            sampleBands(pixels, map, kernels, (QRgb*) polar.scanLine(y), stride);
+        }
+    }
+
+    if (isCanceled()) {
+        return false;
+    }
+
+    m_polarBuffer->setImage(polar, p, source.cacheKey());
+    return true;
+}
+
+/**
+ * Fills result, which has the final size. A map with the final width and
+ * scaled height is sampled straight into the band it takes in the result,
+ * otherwise the sampled image is resized into it.
+ */
+bool Unwrapper::unwrapInto(const SourcePixels& source, const UnwrapMap& map, QImage& result)
+{
+    int scaledHeight = m_parameters->scaledHeight();
+    int top = (result.height() - scaledHeight) / 2;
+
+    if (map.width() == result.width() && map.height() == scaledHeight && top >= 0) {
+        fill(result, 0, top);
+        fill(result, top + scaledHeight, result.height());
+
+        QRgb* outputPixels = (QRgb*) result.scanLine(top);
+        sample(source, map, outputPixels, result.bytesPerLine() / sizeof(QRgb));
+    }
+    else {
+        QImage output = QImage(map.width(), map.height(), result.format());
+        sample(source, map, output);
+
+        if (!isCanceled()) {
+            compose(output, result);
+        }
+    }
+
+    if (isCanceled()) {
+        return false;
+    }
+
+    emit progressChanged(100);
+
+    return true;
+}
+
+/**
+ * Resizes the unwrapped image to the final width, leaving it vertically
+ * centered in a band of scaledHeight() pixels and filling the rest.
+ */
+void Unwrapper::compose(const QImage& unwrapped, QImage& result)
+{
+    int scaledHeight = m_parameters->scaledHeight();
+    QImage finalScaled = unwrapped.scaled(QSize(result.width(), scaledHeight), Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+
+    QPainter p(&result);
+    p.fillRect(result.rect(), m_parameters->fillColor);
+    p.drawImage(QPoint(0, (result.height() - scaledHeight) / 2), finalScaled);
+    p.end();
+}
+
+/**
+ * Fills rows firstRow to lastRow, exclusive, with the fill color.
+ */
+void Unwrapper::fill(QImage& result, int firstRow, int lastRow)
+{
+    if (lastRow <= firstRow) {
+        return;
+    }
+
+    QPainter p(&result);
+    p.fillRect(QRect(0, firstRow, result.width(), lastRow - firstRow), m_parameters->fillColor);
+    p.end();
+}
+
+/**
+ * Fills output, which must have the size of the map, with samples of the
+ * source.
+ */
+void Unwrapper::sample(const SourcePixels& source, const UnwrapMap& map, QImage& output)
+{
+    if (output.width() != map.width() || output.height() != map.height()) {
+        return;
+    }
+
+    sample(source, map, (QRgb*) output.bits(), output.bytesPerLine() / sizeof(QRgb));
+}
+
+/**
+ * Fills map.height() rows of outputStride pixels starting at outputPixels
+ * with samples of the source.
+ */
+void Unwrapper::sample(const SourcePixels& source, const UnwrapMap& map, QRgb* outputPixels, int outputStride)
+{
+    SamplerKernels kernels(findSampler(m_parameters->interpolation), source.format);
+
+    startProgress(map.height());
+    sampleBands(source, map, kernels, outputPixels, outputStride);
+}
+
+/**
+ * Hands the rows of the map to the pool in bands. The calling thread works
+ * on the bands too and only returns once every row is done.
+ */
+void Unwrapper::sampleBands(const SourcePixels& source, const UnwrapMap& map, const SamplerKernels& kernels,
+                            QRgb* outputPixels, int outputStride)
+{
+    int height = map.height();
+    int width = map.width();
+    if (height <= 0 || width <= 0) {
+        return;
+    }
+
+    int threads = qMax(1, threadCount());
+    int bandRows = qMax(int(TileRows), 65536 / width);
+
+    // short maps, as the bands of a stream, still go to every thread
+    bandRows = qMax(1, qMin(bandRows, height / threads));
+    int bands = (height + bandRows - 1) / bandRows;
+    threads = qMin(threads, bands);
+
+    QAtomicInt nextBand(0);
+    m_pool.setMaxThreadCount(threads);
+
+    for (int i = 1; i < threads; i++) {
+        m_pool.start(new SampleBands(this, &source, &map, &kernels,
+                                     outputPixels, outputStride, bandRows, &nextBand));
+    }
+
+    SampleBands(this, &source, &map, &kernels,
+                outputPixels, outputStride, bandRows, &nextBand).run();
+    m_pool.waitForDone();
+}
+
+/**
+ * Streams the final image to sink in bands of bandRows rows, sampling the
+ * mirror at the final size as in a single pass. Only one band of the image
+ * and of the map is in memory at a time. Returns false if canceled or if
+ * the sink failed, in which case its errorString() tells why.
+ */
+bool Unwrapper::unwrap(const QImage& source, UnwrapSink* sink, int bandRows)
+{
+    const UnwrapParameters& p = *m_parameters;
+    QSize finalSize = p.finalSize();
+    int scaledHeight = p.scaledHeight();
+    int top = (finalSize.height() - scaledHeight) / 2;
+
+    if (source.isNull() || finalSize.isEmpty() || scaledHeight <= 0 || bandRows <= 0) {
+        return false;
+    }
+
+    QImage converted;
+    SourcePixels pixels = sourcePixels(source, converted);
+    QImage::Format format = outputFormat(source);
+
+    if (!sink->begin(finalSize, format)) {
+        return false;
+    }
+
+    QImage band(finalSize.width(), qMin(bandRows, finalSize.height()), format);
+    int stride = band.bytesPerLine() / sizeof(QRgb);
+    UnwrapMap map;
+    SamplerKernels kernels(findSampler(p.interpolation), pixels.format);
+
+    startProgress(scaledHeight);
+
+    for (int y = 0; y < finalSize.height(); y += bandRows) {
+        int rows = qMin(bandRows, finalSize.height() - y);
+
+        // rows first to last, exclusive, of the band show the mirror
+        int first = qBound(y, top, y + rows);
+        int last = qBound(y, top + scaledHeight, y + rows);
+
+        fill(band, 0, first - y);
+        fill(band, last - y, rows);
+
+        if (last > first) {
+            map.buildRows(p.center, p.innerRadius, p.outerRadius, finalSize.width(), scaledHeight, p.invert,
+                          first - top, last - first);
+            sampleBands(pixels, map, kernels, (QRgb*) band.scanLine(first - y), stride);
+        }
+
+        if (isCanceled() || !sink->write(band, rows)) {
+            return false;
+        }
+    }
+
+    if (!sink->finish()) {
+        return false;
+    }
+
+    emit progressChanged(100);
+
+    return true;
+}
+
+/**
+ * Samples rows firstRow to lastRow, inclusive, of the output with kernels,
+ * TileRows rows by TileWidth columns at a time. The output stride is in
+ * pixels.
+ */
+void Unwrapper::sampleRows(const SourcePixels& source, const UnwrapMap& map, const SamplerKernels& kernels,
+                           QRgb* outputPixels, int outputStride, int firstRow, int lastRow)
+{
+    int width = map.width();
+    SourceRowFunction function = kernels.pointRow;
+    SourceRowFunction clamped = kernels.clampedRow;
+    FootprintRowFunction footprint = kernels.footprintRow;
+    int reach = kernels.reach;
+
+    // tiles whose kernels read only inside the source
+    QRect inside(reach, reach, source.width - 2 * reach, source.height - 2 * reach);
+
+    for (int top = firstRow; top <= lastRow && !isCanceled(); top += TileRows) {
+        int bottom = qMin(top + TileRows - 1, lastRow);
+
+        for (int x = 0; x < width && !isCanceled(); x += TileWidth) {
+            int count = qMin(int(TileWidth), width - x);
+
+            SourceRowFunction row = function;
+            if (!footprint && function != clamped
+                    && !inside.contains(map.sourceBounds(x, top, count, bottom - top + 1))) {
+                row = clamped;
+            }
+
+            for (int y = top; y <= bottom; y++) {
+                const qint32* points = map.row(y) + 2 * x;
+                QRgb* output = outputPixels + y * outputStride + x;
+
+                if (footprint) {
+                    // the footprint reaches the next row, or the previous one at the end
+                    const qint32* nextPoints = y + 1 < map.height() ? map.row(y + 1) : map.row(qMax(0, y - 1));
+                    footprint(source, points, nextPoints + 2 * x, output, count);
+                }
+                else if (row) {
+                    row(source, points, output, count);
+                }
+                else {
+                    qFill(output, output + count, qRgb(0, 0, 0));
+                }
+            }
+        }
+    }
+
+    reportProgress(lastRow - firstRow + 1);
+}
+
+void Unwrapper::startProgress(int rows)
+{
+    m_rowsDone = 0;
+    m_lastProgress = 0;
+    m_progressRows = rows;
+    m_progressTimer.start();
+}
+
+/**
+ * Called by the workers after each band. Only one of them gets to emit in
+ * each interval, the others just count their rows.
+ */
+void Unwrapper::reportProgress(int rows)
+{
+    int done = m_rowsDone.fetchAndAddOrdered(rows) + rows;
+    if (m_progressRows <= 0) {
+        return;
+    }
+
+    int now = m_progressTimer.elapsed();
+    int last = m_lastProgress;
+
+    if (now - last >= ProgressInterval && m_lastProgress.testAndSetOrdered(last, now)) {
+        emit progressChanged((100 * qint64(done)) / m_progressRows);
+    }
+}
@@ -0,0 +1,195 @@
+/******************************************************************************
+ *
+ * Copyright (c) 2010 Cláudio F. Gil <claudio.f.gil@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+
+#ifndef UNWRAPPER_H
+#define UNWRAPPER_H
+
+#include <QObject>
+#include <QImage>
+#include <QColor>
+#include <QPointF>
+#include <QThreadPool>
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QVector>
+
+#include "unwrapmap.h"
+#include "interpolation.h"
+
+struct UnwrapParameters;
+class UnwrapSink;
+class SourcePyramid;
+class MapCache;
+class PolarBuffer;
+
+/**
+ * Unwraps 360 degree source images taken with a mirror.
+ *
+ * The mirror is sampled through an UnwrapMap, which is kept between calls
+ * and only rebuilt when the geometry changes. The sampled image is split in
+ * bands of rows which are handed to a pool of worker threads. Every pixel
+ * only depends on the map and on the source so the result is the same
+ * whatever the number of threads.
+ *
+ * A row of the map goes all around the mirror, so bands are sampled in
+ * tiles of TileRows by TileWidth pixels instead: each tile reads a small
+ * wedge of the source that stays in the cache while it is sampled. Tiles
+ * that come near the border of the source, as when the outer circle goes
+ * past it, are sampled with the clamped kernel of the sampler, the others
+ * with the unchecked one.
+ *
+ * Sources are read in their own layout when a kernel exists for it, see
+ * SourceFormat, so 24 bit and indexed images are not converted first.
+ * Unwrapped images are always 32 bit.
+ *
+ * unwrap() may run outside the GUI thread. Progress is reported at most
+ * every ProgressInterval milliseconds and cancel() is honored between tiles.
+ */
+class Unwrapper : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit Unwrapper(QObject *parent = 0);
+    ~Unwrapper();
+
+    enum Interpolation {
+        NoInterpolation = 0,
+        BilinearInterpolation,
+        BicubicInterpolation,
+        AreaInterpolation,
+        UserInterpolation = 0x100
+    };
+
+    enum {
+        ProgressInterval = 33,
+        StreamBandRows = 128,
+        TileWidth = UnwrapMap::TileWidth,
+        TileRows = UnwrapMap::TileRows
+    };
+
+    const UnwrapParameters& parameters() const;
+    void setParameters(const UnwrapParameters& parameters);
+
+    int threadCount() const;
+
+    MapCache* mapCache() const;
+    void setMapCache(MapCache* cache);
+
+    PolarBuffer* polarBuffer() const;
+    void setPolarBuffer(PolarBuffer* buffer);
+
+    bool isCanceled() const;
+    void setCanceled(bool canceled);
+
+    static QSize unwrappedSize(qreal innerRadius, qreal outerRadius, int focalPointPercent, int fov);
+    static int finalHeight(int finalWidth, int fov, bool equiRectangular);
+    static int scaledHeight(int finalHeight, int fov, bool equiRectangular);
+
+    QImage unwrap(const QImage& source);
+    QImage unwrap(const QImage& source, const UnwrapMap& map);
+    QImage unwrap(const uchar* sourceBits, int width, int height, int bytesPerLine, QImage::Format format);
+    bool unwrap(const uchar* sourceBits, int width, int height, int bytesPerLine, QImage::Format format,
+                uchar* outputBits, int outputBytesPerLine);
+    QImage unwrap(const SourcePixels& source);
+    QImage unwrap(SourcePyramid* pyramid);
+    bool unwrap(const QImage& source, UnwrapSink* sink, int bandRows = StreamBandRows);
+
+    static QImage::Format outputFormat(const QImage& source);
+    SourcePixels sourcePixels(const QImage& image, QImage& converted);
+
+    void sample(const SourcePixels& source, const UnwrapMap& map, QImage& output);
+    void sample(const SourcePixels& source, const UnwrapMap& map, QRgb* outputPixels, int outputStride);
+    void sampleRows(const SourcePixels& source, const UnwrapMap& map, const SamplerKernels& kernels,
+                    QRgb* outputPixels, int outputStride, int firstRow, int lastRow);
+
+public slots:
+    void cancel();
+
+signals:
+    void progressChanged(int percent);
+
+private:
+    UnwrapParameters* m_parameters;
+    UnwrapMap m_map;
+    MapCache* m_mapCache;
+    PolarBuffer* m_polarBuffer;
+    QThreadPool m_pool;
+    QVector<QRgb> m_colorTable;
+
+    QAtomicInt m_canceled;
+    QAtomicInt m_rowsDone;
+    QAtomicInt m_lastProgress;
+    QElapsedTimer m_progressTimer;
+    int m_progressRows;
+
+    void startProgress(int rows);
+    void reportProgress(int rows);
+    void updateMap(const UnwrapParameters& p);
+    bool samplePolar(const QImage& source, const UnwrapParameters& p);
+    bool unwrapInto(const SourcePixels& source, const UnwrapMap& map, QImage& result);
+    void compose(const QImage& unwrapped, QImage& result);
+    void fill(QImage& result, int firstRow, int lastRow);
+    void sampleBands(const SourcePixels& source, const UnwrapMap& map, const SamplerKernels& kernels,
+                     QRgb* outputPixels, int outputStride);
+
+    Q_DISABLE_COPY(Unwrapper)
+};
+
+/**
+ * Everything that defines an unwrap: the geometry of the mirror in source
+ * pixels, how it is sampled and the size of the final image.
+ */
+struct UnwrapParameters
+{
+    UnwrapParameters();
+
+    QPointF center;
+    qreal innerRadius;
+    qreal outerRadius;
+
+    int fov;
+    int focalPointPercent;
+    Unwrapper::Interpolation interpolation;
+    bool invert;
+
+    int finalWidth;
+    int finalHeight;
+    bool equiRectangular;
+    QColor fillColor;
+
+    // sample at the final size instead of resizing afterwards
+    bool singlePass;
+    int threadCount;
+
+    QSize unwrappedSize() const;
+    QSize finalSize() const;
+    int scaledHeight() const;
+    bool samplesFinalSize() const;
+    QSize mapSize() const;
+    qreal sourceScale() const;
+
+    UnwrapParameters mapped(const QPointF& origin, qreal scale) const;
+};
+
+#endif // UNWRAPPER_H
@@ -0,0 +1,160 @@
+/******************************************************************************
+ *
+ * Copyright (c) 2010 Cláudio F. Gil <claudio.f.gil@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+#include "unwrapsink.h"
+#include "jpegsink.h"
+
+UnwrapSink::~UnwrapSink()
+{
+}
+
+QString UnwrapSink::errorString() const
+{
+    return m_errorString;
+}
+
+void UnwrapSink::setErrorString(const QString& error)
+{
+    m_errorString = error;
+}
+
+/**
+ * Whether create() has a writer for format, given as a file extension.
+ */
+bool UnwrapSink::canStream(const QString& format)
+{
+    QString f = format.toLower();
+
+#ifdef UNWRAP360_JPEG
+    if (f == "jpg" || f == "jpeg") {
+        return true;
+    }
+#endif
+
+    return f == "ppm";
+}
+
+/**
+ * Sink writing path in format, or 0 if format can't be streamed. Quality
+ * goes from 0 to 100 and is ignored by lossless formats.
+ */
+UnwrapSink* UnwrapSink::create(const QString& path, const QString& format, int quality)
+{
+    QString f = format.toLower();
+
+#ifdef UNWRAP360_JPEG
+    if (f == "jpg" || f == "jpeg") {
+        return new JpegSink(path, quality);
+    }
+#else
+    Q_UNUSED(quality);
+#endif
+
+    if (f == "ppm") {
+        return new PpmSink(path);
+    }
+
+    return 0;
+}
+
+PpmSink::PpmSink(const QString& path) :
+    m_file(path)
+{
+}
+
+PpmSink::~PpmSink()
+{
+    abort();
+}
+
+/**
+ * Drops an unfinished image, leaving no partial file behind.
+ */
+void PpmSink::abort()
+{
+    if (m_file.isOpen()) {
+        m_file.close();
+        m_file.remove();
+    }
+}
+
+bool PpmSink::begin(const QSize& size, QImage::Format format)
+{
+    if (format != QImage::Format_RGB32 && format != QImage::Format_ARGB32
+            && format != QImage::Format_ARGB32_Premultiplied) {
+        setErrorString("only 32 bit images can be written");
+        return false;
+    }
+
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        setErrorString(m_file.errorString());
+        return false;
+    }
+
+    m_line.resize(3 * size.width());
+
+    QByteArray header = QString("P6\n%1 %2\n255\n").arg(size.width()).arg(size.height()).toLatin1();
+    if (m_file.write(header) != header.size()) {
+        setErrorString(m_file.errorString());
+        abort();
+        return false;
+    }
+
+    return true;
+}
+
+bool PpmSink::write(const QImage& band, int rows)
+{
+    int width = m_line.size() / 3;
+
+    for (int y = 0; y < rows; y++) {
+        const QRgb* pixels = (const QRgb*) band.scanLine(y);
+        char* line = m_line.data();
+
+        for (int x = 0; x < width; x++) {
+            *line++ = qRed(pixels[x]);
+            *line++ = qGreen(pixels[x]);
+            *line++ = qBlue(pixels[x]);
+        }
+
+        if (m_file.write(m_line) != m_line.size()) {
+            setErrorString(m_file.errorString());
+            abort();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool PpmSink::finish()
+{
+    m_file.close();
+
+    if (m_file.error() != QFile::NoError) {
+        setErrorString(m_file.errorString());
+        m_file.remove();
+        return false;
+    }
+
+    return true;
+}
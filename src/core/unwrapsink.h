@@ -0,0 +1,89 @@
+/******************************************************************************
+ *
+ * Copyright (c) 2010 Cláudio F. Gil <claudio.f.gil@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+#ifndef UNWRAPSINK_H
+#define UNWRAPSINK_H
+
+#include <QFile>
+#include <QImage>
+#include <QSize>
+#include <QString>
+
+/**
+ * Receives an unwrapped image band by band, top to bottom, so that it can
+ * be encoded as it is produced instead of being kept whole in memory.
+ */
+class UnwrapSink
+{
+public:
+    virtual ~UnwrapSink();
+
+    /**
+     * Called once before the first band, with the size of the whole image.
+     */
+    virtual bool begin(const QSize& size, QImage::Format format) = 0;
+
+    /**
+     * Called for each band with its first rows filled, rows being at most
+     * the height of band.
+     */
+    virtual bool write(const QImage& band, int rows) = 0;
+
+    /**
+     * Called once after the last band.
+     */
+    virtual bool finish() = 0;
+
+    QString errorString() const;
+
+    static bool canStream(const QString& format);
+    static UnwrapSink* create(const QString& path, const QString& format, int quality);
+
+protected:
+    void setErrorString(const QString& error);
+
+private:
+    QString m_errorString;
+};
+
+/**
+ * Writes binary PPM, which needs no library and is read by most tools.
+ * Like JpegSink, it removes the file if the image isn't finished.
+ */
+class PpmSink : public UnwrapSink
+{
+public:
+    explicit PpmSink(const QString& path);
+    ~PpmSink();
+
+    bool begin(const QSize& size, QImage::Format format);
+    bool write(const QImage& band, int rows);
+    bool finish();
+
+private:
+    QFile m_file;
+    QByteArray m_line;
+
+    void abort();
+};
+
+#endif // UNWRAPSINK_H
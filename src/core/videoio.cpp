@@ -0,0 +1,381 @@
+/******************************************************************************
+ *
+ * Copyright (c) 2010 Cláudio F. Gil <claudio.f.gil@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+#include <QDir>
+#include <QFileInfo>
+#include <QProcess>
+
+#include "videoio.h"
+
+FrameReader::FrameReader() :
+    m_frameRate(0)
+{
+}
+
+FrameReader::~FrameReader()
+{
+}
+
+/**
+ * Size of the frames, known once open() succeeded.
+ */
+QSize FrameReader::frameSize() const
+{
+    return m_frameSize;
+}
+
+qreal FrameReader::frameRate() const
+{
+    return m_frameRate;
+}
+
+QString FrameReader::errorString() const
+{
+    return m_errorString;
+}
+
+FrameWriter::~FrameWriter()
+{
+}
+
+QString FrameWriter::errorString() const
+{
+    return m_errorString;
+}
+
+/**
+ * ffmpeg is fed raw 32 bit frames.
+ */
+static QImage toFrameFormat(const QImage& image)
+{
+    if (image.format() == QImage::Format_RGB32 || image.format() == QImage::Format_ARGB32) {
+        return image;
+    }
+
+    return image.convertToFormat(image.hasAlphaChannel() ? QImage::Format_ARGB32 : QImage::Format_RGB32);
+}
+
+/**
+ * Raw pixel format of ffmpeg with the memory layout of QImage::Format_RGB32.
+ */
+static QString ffmpegPixelFormat()
+{
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+    return "bgra";
+#else
+    return "argb";
+#endif
+}
+
+ImageSequenceReader::ImageSequenceReader(const QStringList& files, qreal frameRate) :
+    m_files(files),
+    m_next(0)
+{
+    m_frameRate = frameRate;
+}
+
+/**
+ * The first image gives the size of all the frames.
+ */
+bool ImageSequenceReader::open()
+{
+    if (m_files.isEmpty()) {
+        m_errorString = "no frames";
+        return false;
+    }
+
+    if (!m_first.load(m_files.first())) {
+        m_errorString = QString("failed to load %1").arg(m_files.first());
+        return false;
+    }
+
+    m_frameSize = m_first.size();
+    return true;
+}
+
+bool ImageSequenceReader::read(QImage& frame)
+{
+    if (m_next >= m_files.size()) {
+        return false;
+    }
+
+    if (m_next == 0) {
+        frame = m_first;
+        m_first = QImage();
+    }
+    else if (!frame.load(m_files.at(m_next))) {
+        m_errorString = QString("failed to load %1").arg(m_files.at(m_next));
+        return false;
+    }
+
+    if (frame.size() != m_frameSize) {
+        m_errorString = QString("%1 doesn't have the size of the first frame").arg(m_files.at(m_next));
+        return false;
+    }
+
+    m_next++;
+
+    return true;
+}
+
+ImageSequenceWriter::ImageSequenceWriter(const QString& directory, const QString& format, int quality) :
+    m_directory(directory),
+    m_format(format),
+    m_quality(quality),
+    m_next(1)
+{
+}
+
+bool ImageSequenceWriter::open(const QSize& frameSize, qreal frameRate)
+{
+    Q_UNUSED(frameSize);
+    Q_UNUSED(frameRate);
+
+    if (!QDir().mkpath(m_directory)) {
+        m_errorString = QString("cannot create %1").arg(m_directory);
+        return false;
+    }
+
+    return true;
+}
+
+bool ImageSequenceWriter::write(const QImage& frame)
+{
+    QString name = QString("%1.%2").arg(m_next, 6, 10, QChar('0')).arg(m_format);
+    QString path = QDir(m_directory).filePath(name);
+
+    if (!frame.save(path, qPrintable(m_format), m_quality)) {
+        m_errorString = QString("failed to save %1").arg(path);
+        return false;
+    }
+
+    m_next++;
+    return true;
+}
+
+bool ImageSequenceWriter::close()
+{
+    return true;
+}
+
+FfmpegReader::FfmpegReader(const QString& path) :
+    m_path(path),
+    m_process(0)
+{
+}
+
+FfmpegReader::~FfmpegReader()
+{
+    if (m_process) {
+        m_process->kill();
+        m_process->waitForFinished();
+        delete m_process;
+    }
+}
+
+/**
+ * Asks ffprobe for the size and rate of the first video stream. Decoding
+ * only starts with the first read(), in the thread that reads.
+ */
+bool FfmpegReader::open()
+{
+    QStringList arguments;
+    arguments << "-v" << "error"
+              << "-select_streams" << "v:0"
+              << "-show_entries" << "stream=width,height,r_frame_rate"
+              << "-of" << "csv=p=0"
+              << m_path;
+
+    QProcess probe;
+    probe.start("ffprobe", arguments);
+
+    if (!probe.waitForFinished(-1) || probe.exitStatus() != QProcess::NormalExit || probe.exitCode() != 0) {
+        QString error = QString::fromLocal8Bit(probe.readAllStandardError()).trimmed();
+        m_errorString = error.isEmpty() ? QString("cannot run ffprobe") : error;
+        return false;
+    }
+
+    // e.g. "1920,1080,30000/1001"
+    QStringList values = QString::fromLatin1(probe.readAllStandardOutput()).trimmed().split(',');
+    if (values.size() < 3) {
+        m_errorString = QString("%1 has no video").arg(m_path);
+        return false;
+    }
+
+    m_frameSize = QSize(values.at(0).toInt(), values.at(1).toInt());
+
+    QStringList rate = values.at(2).split('/');
+    qreal denominator = rate.size() > 1 ? rate.at(1).toDouble() : 1;
+    m_frameRate = denominator > 0 ? rate.at(0).toDouble() / denominator : 0;
+
+    if (m_frameSize.isEmpty() || m_frameRate <= 0) {
+        m_errorString = QString("%1 has no usable video stream").arg(m_path);
+        return false;
+    }
+
+    return true;
+}
+
+bool FfmpegReader::read(QImage& frame)
+{
+    if (!m_process) {
+        QStringList arguments;
+        arguments << "-v" << "error" << "-nostdin"
+                  << "-i" << m_path
+                  << "-map" << "0:v:0"
+                  << "-f" << "rawvideo"
+                  << "-pix_fmt" << ffmpegPixelFormat()
+                  << "-";
+
+        m_process = new QProcess();
+        m_process->start("ffmpeg", arguments, QIODevice::ReadOnly);
+
+        if (!m_process->waitForStarted(-1)) {
+            m_errorString = "cannot run ffmpeg";
+            return false;
+        }
+    }
+
+    frame = QImage(m_frameSize, QImage::Format_RGB32);
+
+    char* data = (char*) frame.bits();
+    qint64 size = qint64(frame.bytesPerLine()) * frame.height();
+    qint64 done = 0;
+
+    while (done < size) {
+        if (m_process->bytesAvailable() == 0 && !m_process->waitForReadyRead(-1)) {
+            break;
+        }
+
+        qint64 count = m_process->read(data + done, size - done);
+        if (count < 0) {
+            break;
+        }
+
+        done += count;
+    }
+
+    if (done == size) {
+        return true;
+    }
+
+    frame = QImage();
+
+    // a partial frame or a failed ffmpeg is an error, anything else the end
+    m_process->waitForFinished(-1);
+    if (done > 0 || m_process->exitStatus() != QProcess::NormalExit || m_process->exitCode() != 0) {
+        QString error = QString::fromLocal8Bit(m_process->readAllStandardError()).trimmed();
+        m_errorString = error.isEmpty() ? QString("failed to decode %1").arg(m_path) : error;
+    }
+
+    return false;
+}
+
+FfmpegWriter::FfmpegWriter(const QString& path, int quality) :
+    m_path(path),
+    m_quality(qBound(0, quality, 100)),
+    m_frameRate(0),
+    m_process(0)
+{
+}
+
+FfmpegWriter::~FfmpegWriter()
+{
+    if (m_process) {
+        m_process->kill();
+        m_process->waitForFinished();
+        delete m_process;
+    }
+}
+
+bool FfmpegWriter::open(const QSize& frameSize, qreal frameRate)
+{
+    m_frameSize = frameSize;
+    m_frameRate = frameRate;
+
+    QStringList arguments;
+    arguments << "-v" << "error" << "-y"
+              << "-f" << "rawvideo"
+              << "-pix_fmt" << ffmpegPixelFormat()
+              << "-s" << QString("%1x%2").arg(frameSize.width()).arg(frameSize.height())
+              << "-r" << QString::number(frameRate)
+              << "-i" << "-";
+
+    QString suffix = QFileInfo(m_path).suffix().toLower();
+    if (suffix == "mp4" || suffix == "mkv" || suffix == "mov") {
+        // quality 100 is crf 0, lossless, and 0 is crf 51
+        int crf = ((100 - m_quality) * 51) / 100;
+
+        arguments << "-c:v" << "libx264"
+                  << "-crf" << QString::number(crf)
+                  << "-pix_fmt" << "yuv420p"
+                  << "-vf" << "pad=ceil(iw/2)*2:ceil(ih/2)*2";
+    }
+
+    arguments << m_path;
+
+    m_process = new QProcess();
+    m_process->setProcessChannelMode(QProcess::ForwardedErrorChannel);
+    m_process->start("ffmpeg", arguments, QIODevice::WriteOnly);
+
+    if (!m_process->waitForStarted(-1)) {
+        m_errorString = "cannot run ffmpeg";
+        return false;
+    }
+
+    return true;
+}
+
+bool FfmpegWriter::write(const QImage& frame)
+{
+    QImage image = frame.size() == m_frameSize ? toFrameFormat(frame) : QImage();
+    if (image.isNull()) {
+        m_errorString = "frame doesn't have the size of the video";
+        return false;
+    }
+
+    // constBits() so that the copy shared with frame isn't detached
+    m_process->write((const char*) image.constBits(), qint64(image.bytesPerLine()) * image.height());
+
+    // keep at most one frame buffered
+    while (m_process->bytesToWrite() > 0) {
+        if (!m_process->waitForBytesWritten(-1)) {
+            m_errorString = QString("ffmpeg stopped writing %1").arg(m_path);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool FfmpegWriter::close()
+{
+    m_process->closeWriteChannel();
+
+    if (!m_process->waitForFinished(-1) || m_process->exitStatus() != QProcess::NormalExit
+            || m_process->exitCode() != 0) {
+        m_errorString = QString("ffmpeg failed to write %1").arg(m_path);
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,151 @@
+/******************************************************************************
+ *
+ * Copyright (c) 2010 Cláudio F. Gil <claudio.f.gil@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+#ifndef VIDEOIO_H
+#define VIDEOIO_H
+
+#include <QImage>
+#include <QSize>
+#include <QString>
+#include <QStringList>
+
+class QProcess;
+
+/**
+ * Source of video frames. open() is called before anything else. read()
+ * may then be called from another thread, but always the same one.
+ */
+class FrameReader
+{
+public:
+    FrameReader();
+    virtual ~FrameReader();
+
+    virtual bool open() = 0;
+    virtual bool read(QImage& frame) = 0;
+
+    QSize frameSize() const;
+    qreal frameRate() const;
+    QString errorString() const;
+
+protected:
+    QSize m_frameSize;
+    qreal m_frameRate;
+    QString m_errorString;
+};
+
+/**
+ * Destination of video frames. All calls come from the same thread.
+ */
+class FrameWriter
+{
+public:
+    virtual ~FrameWriter();
+
+    virtual bool open(const QSize& frameSize, qreal frameRate) = 0;
+    virtual bool write(const QImage& frame) = 0;
+    virtual bool close() = 0;
+
+    QString errorString() const;
+
+protected:
+    QString m_errorString;
+};
+
+/**
+ * Reads numbered image files in the given order. It stands in for a video
+ * decoder and needs nothing but Qt.
+ */
+class ImageSequenceReader : public FrameReader
+{
+public:
+    ImageSequenceReader(const QStringList& files, qreal frameRate);
+
+    bool open();
+    bool read(QImage& frame);
+
+private:
+    QStringList m_files;
+    int m_next;
+    QImage m_first;
+};
+
+/**
+ * Writes frames as numbered image files in a directory.
+ */
+class ImageSequenceWriter : public FrameWriter
+{
+public:
+    ImageSequenceWriter(const QString& directory, const QString& format, int quality);
+
+    bool open(const QSize& frameSize, qreal frameRate);
+    bool write(const QImage& frame);
+    bool close();
+
+private:
+    QString m_directory;
+    QString m_format;
+    int m_quality;
+    int m_next;
+};
+
+/**
+ * Decodes a video file by running the ffmpeg tool and reading raw frames
+ * from its output, so no FFmpeg library is linked.
+ */
+class FfmpegReader : public FrameReader
+{
+public:
+    explicit FfmpegReader(const QString& path);
+    ~FfmpegReader();
+
+    bool open();
+    bool read(QImage& frame);
+
+private:
+    QString m_path;
+    QProcess* m_process;
+};
+
+/**
+ * Encodes a video file by running the ffmpeg tool and feeding it raw
+ * frames. The container and codec follow from the file extension.
+ */
+class FfmpegWriter : public FrameWriter
+{
+public:
+    FfmpegWriter(const QString& path, int quality);
+    ~FfmpegWriter();
+
+    bool open(const QSize& frameSize, qreal frameRate);
+    bool write(const QImage& frame);
+    bool close();
+
+private:
+    QString m_path;
+    int m_quality;
+    QSize m_frameSize;
+    qreal m_frameRate;
+    QProcess* m_process;
+};
+
+#endif // VIDEOIO_H
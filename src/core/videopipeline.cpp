@@ -0,0 +1,363 @@
+/******************************************************************************
+ *
+ * Copyright (c) 2010 Cláudio F. Gil <claudio.f.gil@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+#include <QElapsedTimer>
+#include <QMap>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
+
+#include "videopipeline.h"
+#include "framequeue.h"
+#include "videoio.h"
+#include "mapcache.h"
+#include "mirrortracker.h"
+
+/**
+ * Reads frames until the end of the video or until the pipeline fails,
+ * tracking the mirror in each of them if asked to.
+ */
+class DecodeStage : public QRunnable
+{
+public:
+    DecodeStage(VideoPipeline* pipeline, FrameQueue* decoded) :
+        m_pipeline(pipeline), m_decoded(decoded)
+    {
+    }
+
+    void run()
+    {
+        FrameReader* reader = m_pipeline->m_reader;
+        UnwrapParameters parameters = m_pipeline->m_parameters;
+        UnwrapMap map = m_pipeline->m_map;
+        QImage image;
+        int index = 0;
+
+        MirrorTracker tracker;
+        tracker.reset(parameters.center, parameters.innerRadius, parameters.outerRadius);
+
+        while (!m_pipeline->isFailed() && reader->read(image)) {
+            if (m_pipeline->m_tracking && tracker.track(image)
+                    && tracker.distance(parameters) > m_pipeline->m_trackingThreshold) {
+                UnwrapParameters moved = parameters;
+                tracker.apply(moved);
+
+                // same size as the first map, which the writer expects
+                UnwrapMap movedMap;
+                movedMap.build(moved.center, moved.innerRadius, moved.outerRadius,
+                               map.width(), map.height(), moved.invert);
+
+                if (!movedMap.isNull()) {
+                    parameters = moved;
+                    map = movedMap;
+                    m_pipeline->m_mapUpdates++;
+                }
+            }
+
+            if (!m_decoded->push(VideoFrame(index++, image, map))) {
+                break;
+            }
+        }
+
+        if (!reader->errorString().isEmpty()) {
+            m_pipeline->fail(reader->errorString());
+        }
+
+        m_decoded->close();
+    }
+
+private:
+    VideoPipeline* m_pipeline;
+    FrameQueue* m_decoded;
+};
+
+/**
+ * Unwraps decoded frames with its own Unwrapper and the map of each. After
+ * a failure it keeps draining the queue so the decoder never blocks, and
+ * the last worker to finish closes the queue of unwrapped frames.
+ */
+class UnwrapStage : public QRunnable
+{
+public:
+    UnwrapStage(VideoPipeline* pipeline, FrameQueue* decoded, FrameQueue* unwrapped, QAtomicInt* running) :
+        m_pipeline(pipeline), m_decoded(decoded), m_unwrapped(unwrapped), m_running(running)
+    {
+    }
+
+    void run()
+    {
+        UnwrapParameters parameters = m_pipeline->m_parameters;
+        parameters.threadCount = 1;
+
+        Unwrapper unwrapper;
+        unwrapper.setParameters(parameters);
+
+        VideoFrame frame;
+        while (m_decoded->pop(frame)) {
+            if (m_pipeline->isFailed()) {
+                continue;
+            }
+
+            frame.image = unwrapper.unwrap(frame.image, frame.map);
+            frame.map = UnwrapMap();
+            if (frame.image.isNull()) {
+                m_pipeline->fail(QString("failed to unwrap frame %1").arg(frame.index + 1));
+                continue;
+            }
+
+            m_unwrapped->push(frame);
+        }
+
+        if (!m_running->deref()) {
+            m_unwrapped->close();
+        }
+    }
+
+private:
+    VideoPipeline* m_pipeline;
+    FrameQueue* m_decoded;
+    FrameQueue* m_unwrapped;
+    QAtomicInt* m_running;
+};
+
+VideoPipeline::VideoPipeline(FrameReader* reader, FrameWriter* writer, QObject *parent) :
+    QObject(parent),
+    m_reader(reader),
+    m_writer(writer),
+    m_mapCache(0),
+    m_tracking(false),
+    m_trackingThreshold(0.5),
+    m_mapUpdates(0),
+    m_workerCount(QThread::idealThreadCount()),
+    m_queueSize(4),
+    m_frameCount(0),
+    m_framesPerSecond(0),
+    m_failed(0)
+{
+}
+
+void VideoPipeline::setParameters(const UnwrapParameters& parameters)
+{
+    m_parameters = parameters;
+}
+
+/**
+ * Cache to take the map from, or 0 to always build it.
+ */
+void VideoPipeline::setMapCache(MapCache* cache)
+{
+    m_mapCache = cache;
+}
+
+bool VideoPipeline::isTracking() const
+{
+    return m_tracking;
+}
+
+/**
+ * Whether to follow the mirror as the rig moves, starting from the
+ * geometry of the parameters.
+ */
+void VideoPipeline::setTracking(bool tracking)
+{
+    m_tracking = tracking;
+}
+
+qreal VideoPipeline::trackingThreshold() const
+{
+    return m_trackingThreshold;
+}
+
+/**
+ * Distance, in source pixels, the tracked circles must move before the
+ * map is built again. Smaller moves are not worth a new map.
+ */
+void VideoPipeline::setTrackingThreshold(qreal pixels)
+{
+    m_trackingThreshold = qMax(qreal(0), pixels);
+}
+
+int VideoPipeline::workerCount() const
+{
+    return m_workerCount;
+}
+
+/**
+ * Number of frames unwrapped at the same time. Zero means one per core.
+ */
+void VideoPipeline::setWorkerCount(int count)
+{
+    m_workerCount = count > 0 ? count : QThread::idealThreadCount();
+}
+
+int VideoPipeline::queueSize() const
+{
+    return m_queueSize;
+}
+
+/**
+ * Frames that may wait between two stages.
+ */
+void VideoPipeline::setQueueSize(int size)
+{
+    m_queueSize = qMax(1, size);
+}
+
+/**
+ * Unwraps the whole video and waits for it. The reader must already be
+ * open, so that the parameters could be set from its frame size. Returns
+ * false on errors or if canceled.
+ */
+bool VideoPipeline::run()
+{
+    m_failed = 0;
+    m_errorString.clear();
+    m_frameCount = 0;
+    m_framesPerSecond = 0;
+    m_mapUpdates = 0;
+
+    if (m_reader->frameSize().isEmpty()) {
+        m_errorString = "the video is not open";
+        return false;
+    }
+
+    if (m_mapCache) {
+        m_map = m_mapCache->map(m_parameters);
+    }
+    else {
+        QSize mapSize = m_parameters.mapSize();
+        m_map.build(m_parameters.center, m_parameters.innerRadius, m_parameters.outerRadius,
+                    mapSize.width(), mapSize.height(), m_parameters.invert);
+    }
+
+    if (m_map.isNull()) {
+        m_errorString = "nothing to unwrap with the given radii";
+        return false;
+    }
+
+    if (!m_writer->open(m_parameters.finalSize(), m_reader->frameRate())) {
+        m_errorString = m_writer->errorString();
+        return false;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    FrameQueue decoded(m_queueSize);
+    FrameQueue unwrapped(m_queueSize);
+    QAtomicInt running(m_workerCount);
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(m_workerCount + 1);
+    pool.start(new DecodeStage(this, &decoded));
+
+    for (int i = 0; i < m_workerCount; i++) {
+        pool.start(new UnwrapStage(this, &decoded, &unwrapped, &running));
+    }
+
+    // frames come out of order, keep them until their turn
+    QMap<int, QImage> pending;
+    VideoFrame frame;
+    int next = 0;
+
+    while (unwrapped.pop(frame)) {
+        if (isFailed()) {
+            continue;
+        }
+
+        pending.insert(frame.index, frame.image);
+
+        while (pending.contains(next) && !isFailed()) {
+            if (!m_writer->write(pending.take(next))) {
+                fail(m_writer->errorString());
+                break;
+            }
+
+            emit frameWritten(next);
+            next++;
+        }
+    }
+
+    pool.waitForDone();
+
+    if (!isFailed() && !m_writer->close()) {
+        fail(m_writer->errorString());
+    }
+
+    m_frameCount = next;
+    m_framesPerSecond = next / qMax(0.001, timer.elapsed() / 1000.0);
+
+    return !isFailed();
+}
+
+/**
+ * Frames written by the last run().
+ */
+int VideoPipeline::frameCount() const
+{
+    return m_frameCount;
+}
+
+/**
+ * Throughput of the last run(), from the first frame read to the last one
+ * written.
+ */
+qreal VideoPipeline::framesPerSecond() const
+{
+    return m_framesPerSecond;
+}
+
+/**
+ * Maps built again by the last run() because the mirror moved.
+ */
+int VideoPipeline::mapUpdates() const
+{
+    return m_mapUpdates;
+}
+
+QString VideoPipeline::errorString() const
+{
+    return m_errorString;
+}
+
+void VideoPipeline::cancel()
+{
+    fail("canceled");
+}
+
+bool VideoPipeline::isFailed() const
+{
+    return m_failed != 0;
+}
+
+/**
+ * Stops every stage. Only the first error is kept.
+ */
+void VideoPipeline::fail(const QString& error)
+{
+    QMutexLocker locker(&m_errorMutex);
+
+    if (m_failed.testAndSetOrdered(0, 1)) {
+        m_errorString = error;
+    }
+}
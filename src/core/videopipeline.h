@@ -0,0 +1,115 @@
+/******************************************************************************
+ *
+ * Copyright (c) 2010 Cláudio F. Gil <claudio.f.gil@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+#ifndef VIDEOPIPELINE_H
+#define VIDEOPIPELINE_H
+
+#include <QAtomicInt>
+#include <QMutex>
+#include <QObject>
+#include <QString>
+
+#include "unwrapmap.h"
+#include "unwrapper.h"
+
+class FrameReader;
+class FrameWriter;
+class MapCache;
+
+/**
+ * Unwraps every frame of a video.
+ *
+ * Decoding, unwrapping and encoding run at the same time: one thread reads
+ * frames, several unwrap them through a single shared map and the calling
+ * thread writes them back in order. The stages are linked by bounded
+ * queues so memory stays at a few frames whatever the length of the video.
+ *
+ * Each frame is unwrapped by one thread, which scales better than sharing
+ * the rows of one frame between all of them.
+ *
+ * With tracking, the decoder follows the mirror from frame to frame with a
+ * MirrorTracker and builds a new map when it has moved more than the
+ * threshold. Frames carry the map they are unwrapped with.
+ */
+class VideoPipeline : public QObject
+{
+    Q_OBJECT
+
+public:
+    VideoPipeline(FrameReader* reader, FrameWriter* writer, QObject *parent = 0);
+
+    void setParameters(const UnwrapParameters& parameters);
+    void setMapCache(MapCache* cache);
+
+    bool isTracking() const;
+    void setTracking(bool tracking);
+
+    qreal trackingThreshold() const;
+    void setTrackingThreshold(qreal pixels);
+
+    int workerCount() const;
+    void setWorkerCount(int count);
+
+    int queueSize() const;
+    void setQueueSize(int size);
+
+    bool run();
+
+    int frameCount() const;
+    qreal framesPerSecond() const;
+    int mapUpdates() const;
+    QString errorString() const;
+
+public slots:
+    void cancel();
+
+signals:
+    void frameWritten(int frame);
+
+private:
+    friend class DecodeStage;
+    friend class UnwrapStage;
+
+    FrameReader* m_reader;
+    FrameWriter* m_writer;
+    UnwrapParameters m_parameters;
+    UnwrapMap m_map;
+    MapCache* m_mapCache;
+
+    bool m_tracking;
+    qreal m_trackingThreshold;
+    int m_mapUpdates;
+
+    int m_workerCount;
+    int m_queueSize;
+    int m_frameCount;
+    qreal m_framesPerSecond;
+
+    QAtomicInt m_failed;
+    QMutex m_errorMutex;
+    QString m_errorString;
+
+    bool isFailed() const;
+    void fail(const QString& error);
+};
+
+#endif // VIDEOPIPELINE_H
@@ -25,6 +25,7 @@
 #include <QGraphicsTextItem>
 #include <QVector2D>
 #include <QSettings>
+#include <QtConcurrentRun>
 
 #include "imagearea.h"
 #include "imagemarker.h"
@@ -33,6 +34,7 @@
 
 ImageArea::ImageArea(QWidget *parent) :
     QGraphicsView(parent),
+    m_pyramid(0),
     m_showCircles(true),
     m_frame(0), m_centerMarker(0),
     m_innerMarker(0), m_outerMarker(0),
@@ -46,10 +48,15 @@ ImageArea::ImageArea(QWidget *parent) :
     scene->setItemIndexMethod(QGraphicsScene::NoIndex);
 
     setScene(scene);
+
+    m_tiles.setMaxCost(TileCacheSize);
+
+    connect(&m_levelWatcher, SIGNAL(finished()), SLOT(levelBuilt()));
 }
 
 ImageArea::~ImageArea()
 {
+    m_levelWatcher.waitForFinished();
     saveSettings();
 }
 
@@ -62,16 +69,35 @@ void ImageArea::setEmptyMessage(const QString &message) {
 }
 
 void ImageArea::setImage(const QImage &image) {
+    m_levels.setImage(image);
+    showLevels(&m_levels);
+}
+
+/**
+ * Shows the image of source, drawn from its levels. The pyramid is not
+ * owned and must outlive its use here.
+ */
+void ImageArea::setSource(SourcePyramid* source)
+{
+    m_levels.clear();
+    showLevels(source);
+}
+
+void ImageArea::showLevels(SourcePyramid* pyramid)
+{
     saveSettings();
     clearScene();
 
-    m_pixmap = QPixmap::fromImage(image);
-    if (m_pixmap.isNull()) {
+    m_pyramid = pyramid;
+    m_image = pyramid ? pyramid->image() : QImage();
+    m_tiles.clear();
+
+    if (m_image.isNull()) {
         return;
     }
 
-    scene()->setSceneRect(m_pixmap.rect());
-    fitInView(m_pixmap.rect(), Qt::KeepAspectRatio);    
+    scene()->setSceneRect(m_image.rect());
+    fitInView(m_image.rect(), Qt::KeepAspectRatio);    
 
     setupMarkers();
 }
@@ -105,7 +131,7 @@ void ImageArea::setupMarkers()
         return;
     }
 
-    m_frame = scene()->addRect(m_pixmap.rect());
+    m_frame = scene()->addRect(m_image.rect());
     m_frame->setPen(QPen(QBrush(), 0, Qt::NoPen));
 
     QSettings settings;
@@ -129,8 +155,8 @@ ImageMarker* ImageArea::createMarker(int x, int y, bool inFrame, const QColor &c
 {
     int s = 100;
 
-    int cx = m_pixmap.rect().center().x();
-    int cy = m_pixmap.rect().center().y();
+    int cx = m_image.rect().center().x();
+    int cy = m_image.rect().center().y();
 
     ImageMarker* marker = new ImageMarker(this);
     marker->setRect(cx - (s / 2), cy - (s / 2), s, s);
@@ -156,9 +182,86 @@ void ImageArea::zoomOut() {
     scale(1 / qreal(1.2), 1 / qreal(1.2));
 }
 
+/**
+ * Draws the visible tiles of the smallest level that still has a pixel per
+ * pixel of the view. Until that level is built, the closest one already
+ * built is drawn instead.
+ */
 void ImageArea::drawBackground(QPainter *painter, const QRectF &rect) {
     painter->fillRect(rect, palette().color(QPalette::Background));
-    painter->drawPixmap(rect, m_pixmap, rect);
+
+    if (m_image.isNull()) {
+        return;
+    }
+
+    int wanted = m_pyramid->levelFor(transform().m11());
+    int level;
+    QImage image = m_pyramid->builtLevel(wanted, level);
+    if (level < wanted) {
+        buildLevel(wanted);
+    }
+
+    qreal scale = SourcePyramid::levelScale(level);
+
+    QRectF levelRect(rect.topLeft() * scale, rect.size() * scale);
+    QRect visible = levelRect.toAlignedRect() & image.rect();
+    if (visible.isEmpty()) {
+        return;
+    }
+
+    for (int y = visible.top() / TileSize; y <= visible.bottom() / TileSize; y++) {
+        for (int x = visible.left() / TileSize; x <= visible.right() / TileSize; x++) {
+            QPixmap pixmap = tile(image, level, x, y);
+
+            QRectF target(x * TileSize / scale, y * TileSize / scale,
+                          pixmap.width() / scale, pixmap.height() / scale);
+            painter->drawPixmap(target, pixmap, pixmap.rect());
+        }
+    }
+}
+
+/**
+ * Builds level of the shown pyramid on the global pool, unless a level is
+ * being built already; the next paint asks again if it needs another one.
+ */
+void ImageArea::buildLevel(int level)
+{
+    if (m_levelWatcher.isRunning()) {
+        return;
+    }
+
+    m_levelWatcher.setFuture(QtConcurrent::run(m_pyramid, &SourcePyramid::level, level));
+}
+
+/**
+ * Redraws the background with the level just built.
+ */
+void ImageArea::levelBuilt()
+{
+    resetCachedContent();
+    viewport()->update();
+}
+
+/**
+ * Tile x, y of level, uploaded the first time it is drawn and kept until
+ * the cache runs out of room.
+ */
+QPixmap ImageArea::tile(const QImage& image, int level, int x, int y)
+{
+    quint64 key = (quint64(level) << 48) | (quint64(y) << 24) | quint64(x);
+
+    QPixmap* cached = m_tiles.object(key);
+    if (cached) {
+        return *cached;
+    }
+
+    QRect rect = QRect(x * TileSize, y * TileSize, TileSize, TileSize) & image.rect();
+    QPixmap* pixmap = new QPixmap(QPixmap::fromImage(image.copy(rect)));
+
+    QPixmap result = *pixmap;
+    m_tiles.insert(key, pixmap, qMax(1, rect.width() * rect.height() * 4 / 1024));
+
+    return result;
 }
 
 void ImageArea::updateCircles() {
@@ -174,10 +277,10 @@ void ImageArea::updateCircles() {
         delete m_innerCircle;
     }
 
-    QRect pixmapRect = m_pixmap.rect();
+    QRect pixmapRect = m_image.rect();
     QPoint pixmapCenter = pixmapRect.center();
 
-    m_center = m_centerMarker->scenePos() + m_pixmap.rect().center();
+    m_center = m_centerMarker->scenePos() + m_image.rect().center();
 
     qreal innerRadius = QVector2D(m_innerMarker->pos()).length();
     if (innerRadius != m_innerRadius) {
@@ -210,17 +313,19 @@ void ImageArea::updateCircles() {
     m_outerCircle->setPen(QPen(Qt::red));
     m_outerCircle->setParentItem(m_frame);
     m_outerCircle->setPos(pixmapCenter.x(), pixmapCenter.y());
+
+    emit circlesChanged();
 }
 
 QString ImageArea::settingsKey(const QString& param) {
     return QString("ImageArea360/size_%1x%2/%3")
-            .arg(m_pixmap.size().width())
-            .arg(m_pixmap.size().height())
+            .arg(m_image.size().width())
+            .arg(m_image.size().height())
             .arg(param);
 }
 
 void ImageArea::saveSettings() {
-    if (m_pixmap.isNull()) {
+    if (m_image.isNull()) {
         return;
     }
 
@@ -237,7 +342,7 @@ void ImageArea::saveSettings() {
 
 QImage ImageArea::image() const
 {
-    return m_pixmap.toImage();
+    return m_image;
 }
 
 QPointF ImageArea::center() const
@@ -264,3 +369,35 @@ void ImageArea::setShowCircles(bool show)
 {
     m_showCircles = show;
 }
+
+/**
+ * Moves the markers onto the given circles, keeping their directions.
+ */
+void ImageArea::setCircles(const QPointF& center, qreal innerRadius, qreal outerRadius)
+{
+    if (!m_centerMarker) {
+        return;
+    }
+
+    m_centerMarker->setPos(center - m_image.rect().center());
+
+    // the inner marker can't go past the outer one, so the growing one moves first
+    if (outerRadius >= m_outerRadius) {
+        placeMarker(m_outerMarker, outerRadius);
+        placeMarker(m_innerMarker, innerRadius);
+    }
+    else {
+        placeMarker(m_innerMarker, innerRadius);
+        placeMarker(m_outerMarker, outerRadius);
+    }
+}
+
+void ImageArea::placeMarker(ImageMarker* marker, qreal radius)
+{
+    QVector2D direction(marker->pos());
+    if (direction.isNull()) {
+        direction = QVector2D(1, 0);
+    }
+
+    marker->setPos((direction.normalized() * radius).toPointF());
+}
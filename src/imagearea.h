@@ -26,9 +26,23 @@
 
 #include <QGraphicsView>
 #include <QGraphicsItem>
+#include <QCache>
+#include <QFutureWatcher>
+
+#include "sourcepyramid.h"
 
 class ImageMarker;
 
+/**
+ * Shows an image with the markers of the mirror circles.
+ *
+ * The image is drawn from tiles of its half resolution levels, only those
+ * in view and at the level matching the zoom. Tiles become pixmaps when
+ * first drawn and are kept in a cache of at most TileCacheSize kilobytes.
+ * A source shown with setSource() shares the levels of its pyramid, other
+ * images get levels of their own. Missing levels are built in the
+ * background, and the closest level already built is drawn meanwhile.
+ */
 class ImageArea : public QGraphicsView
 {
     Q_OBJECT
@@ -37,8 +51,14 @@ public:
     explicit ImageArea(QWidget *parent = 0);
     ~ImageArea();
 
+    enum {
+        TileSize = 256,
+        TileCacheSize = 64 * 1024
+    };
+
     QImage image() const;
     void setImage(const QImage &image);
+    void setSource(SourcePyramid* source);
 
     bool showCircles();
     void setShowCircles(bool show);
@@ -47,6 +67,8 @@ public:
     qreal innerRadius() const;
     qreal outerRadius() const;
 
+    void setCircles(const QPointF& center, qreal innerRadius, qreal outerRadius);
+
 public slots:
     void setEmptyMessage(const QString& message);
 
@@ -54,16 +76,24 @@ public slots:
     void zoomIn();
     void zoomOut();
 
+private slots:
+    void levelBuilt();
+
 signals:
     void innerRadiusChanged(qreal radius);
     void outerRadiusChanged(qreal radius);
+    void circlesChanged();
 
 protected:
     void drawBackground(QPainter *painter, const QRectF &rect);
 
 private:
     QString m_message;
-    QPixmap m_pixmap;
+    QImage m_image;
+    SourcePyramid m_levels;
+    SourcePyramid* m_pyramid;
+    QCache<quint64, QPixmap> m_tiles;
+    QFutureWatcher<QImage> m_levelWatcher;
 
     bool m_showCircles;
     QPointF m_center;
@@ -77,12 +107,16 @@ private:
     QGraphicsEllipseItem* m_innerCircle;
     QGraphicsEllipseItem* m_outerCircle;
 
+    void showLevels(SourcePyramid* pyramid);
     void clearScene();
     void setupMarkers();
     void updatePixmap();
+    void buildLevel(int level);
+    QPixmap tile(const QImage& image, int level, int x, int y);
     QString settingsKey(const QString& param);
     void saveSettings();
     ImageMarker* createMarker(int x, int y, bool inFrame, const QColor& color);
+    void placeMarker(ImageMarker* marker, qreal radius);
 };
 
 #endif // IMAGEAREA_H
@@ -24,21 +24,21 @@
 #include <QFileDialog>
 #include <QMessageBox>
 #include <QDesktopWidget>
+#include <QStatusBar>
+#include <QtConcurrentRun>
 
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
 #include "fullscreenexitbutton.h"
 #include "settingsdialog.h"
 
-QRgb identityInterpolation(const QRgb* pixels, int width, const QPointF& point);
-QRgb bilinearInterpolation(const QRgb* pixels, int width, const QPointF& point);
-QRgb bicubicInterpolation(const QRgb* pixels, int width, const QPointF& point);
-
 MainWindow::MainWindow(QWidget *parent) :
     QMainWindow(parent),
     ui(new Ui::MainWindow),
     m_fseButton(0),
-    m_settingsDialog(0)
+    m_settingsDialog(0),
+    m_unwrapTime(0),
+    m_detectSourceKey(0)
 {
 
     ui->setupUi(this);
@@ -56,14 +56,31 @@ MainWindow::MainWindow(QWidget *parent) :
 
     ui->cancelButton->setVisible(false);
     ui->progressBar->setVisible(false);
+    ui->previewLabel->setVisible(false);
 
     m_settingsDialog = new SettingsDialog(QApplication::desktop()->screen());
     connect(ui->sourceImage, SIGNAL(outerRadiusChanged(qreal)), m_settingsDialog, SLOT(setOuterRadius(qreal)));
     connect(ui->sourceImage, SIGNAL(innerRadiusChanged(qreal)), m_settingsDialog, SLOT(setInnerRadius(qreal)));
+
+    m_unwrapper.setMapCache(&m_mapCache);
+    m_unwrapper.setPolarBuffer(&m_polar);
+    connect(&m_unwrapper, SIGNAL(progressChanged(int)), ui->progressBar, SLOT(setValue(int)));
+    connect(&m_unwrapWatcher, SIGNAL(finished()), SLOT(unwrapFinished()));
+    connect(&m_saveWatcher, SIGNAL(finished()), SLOT(saveFinished()));
+    connect(&m_detectWatcher, SIGNAL(finished()), SLOT(detectFinished()));
+
+    m_preview.setSource(&m_pyramid);
+    connect(ui->sourceImage, SIGNAL(circlesChanged()), SLOT(updatePreview()));
+    connect(&m_preview, SIGNAL(previewReady(QImage)), SLOT(showPreview(QImage)));
 }
 
 MainWindow::~MainWindow()
 {
+    m_unwrapper.cancel();
+    m_unwrapWatcher.waitForFinished();
+    m_saveWatcher.waitForFinished();
+    m_detectWatcher.waitForFinished();
+
     delete ui;
     delete m_settingsDialog;
 }
@@ -88,6 +105,10 @@ void MainWindow::loadImage() {
 
     bool loaded = m_source.load(path);
     if (loaded) {
+        // previews of the previous image must not show up over this one
+        m_preview.cancel();
+        m_pyramid.setImage(m_source);
+        m_polar.clear();
         setupSourceImage();
     }
 
@@ -98,133 +119,75 @@ void MainWindow::loadImage() {
 
 void MainWindow::showSettings() {
     m_settingsDialog->exec();
+    updatePreview();
 }
 
 void MainWindow::processSourceImage() {
-    if (m_source.isNull()) {
+    if (m_source.isNull() || m_unwrapWatcher.isRunning()) {
         return;
     }
 
-    ui->loadImageButton->setEnabled(false);
-    ui->zoomInButton->setEnabled(false);
-    ui->zoomOutButton->setEnabled(false);
-    ui->settingsButton->setEnabled(false);
-    ui->goBackButton->setEnabled(false);
-    ui->processButton->setEnabled(false);
-    ui->fullScreenButton->setEnabled(false);
+    setProcessing(true);
 
-    ui->action_ChooseImage->setEnabled(false);
-    ui->action_SaveUnrappedImage->setEnabled(false);
-    ui->action_Settings->setEnabled(false);
-    ui->action_Unwrap->setEnabled(false);
-
-    unwrap();
-
-    ui->loadImageButton->setEnabled(true);
-    ui->zoomInButton->setEnabled(true);
-    ui->zoomOutButton->setEnabled(true);
-    ui->settingsButton->setEnabled(true);
-    ui->goBackButton->setEnabled(true);
-    ui->processButton->setEnabled(true);
-    ui->fullScreenButton->setEnabled(true);
+    UnwrapParameters parameters = m_settingsDialog->parameters();
+    parameters.center = ui->sourceImage->center();
+    parameters.innerRadius = ui->sourceImage->innerRadius();
+    parameters.outerRadius = ui->sourceImage->outerRadius();
 
-    ui->action_ChooseImage->setEnabled(true);
-    ui->action_Settings->setEnabled(true);
-    ui->action_Unwrap->setEnabled(true);
+    m_result = QImage();
 
-    if (! m_result.isNull()) {
-        ui->sourceImage->setShowCircles(false);
-        ui->sourceImage->setImage(m_result);
-        ui->saveImageButton->setEnabled(true);
+    m_unwrapper.setParameters(parameters);
+    m_unwrapper.setCanceled(false);
+    m_unwrapTimer.start();
 
-        ui->action_SaveUnrappedImage->setEnabled(true);
-    }
+    // reads a smaller level of the pyramid when the final size allows it
+    QImage (Unwrapper::*unwrap)(SourcePyramid*) = &Unwrapper::unwrap;
+    m_unwrapWatcher.setFuture(QtConcurrent::run(&m_unwrapper, unwrap, &m_pyramid));
 }
 
-void MainWindow::unwrap()
+void MainWindow::unwrapFinished()
 {
-    SettingsDialog::ImageInterpolation interpolation = m_settingsDialog->interpolation();
-    bool invert = m_settingsDialog->invertFinalImage();
-
-    int sourceWidth = m_source.width();
-    int height = m_settingsDialog->resultHeight();
-    int width  = m_settingsDialog->resultWidth();
-    int pixels = height * width;
-    QImage output = QImage(width, height, m_source.format());
-
-    const QRgb* sourcePixels = (const QRgb*) m_source.bits();
-    QRgb* outputPixels = (QRgb*) output.bits();
-
-    QPointF center = ui->sourceImage->center();
-    qreal innerRadius = ui->sourceImage->innerRadius();
-    qreal outerRadius = ui->sourceImage->outerRadius();
+    m_result = m_unwrapWatcher.result();
+    m_unwrapTime = m_unwrapTimer.elapsed();
 
-    ui->cancelButton->setVisible(true);
-    ui->progressBar->setVisible(true);
+    setProcessing(false);
 
-    QTransform transform;
-
-    m_result = QImage();
-    m_cancel = false;
-
-    QPointF referencePoint(1, 0);
-
-    for (int y = 0; !m_cancel && y < height; y++) {
-        int usedY = invert ? height - (y + 1) : y;
-        float ro = innerRadius + ((usedY * (outerRadius - innerRadius))  / height);
-
-        int offset = y * width;
-
-        for (int x = 0; !m_cancel && x < width; x++) {
-            float ang = (360.0 * x) / width;
-
-            transform.reset();
-            transform.scale(ro, ro);
-            transform.rotate(-ang); // mirrors reflect
-
-            QPointF point = transform.map(referencePoint) + center;
-            QRgb rgb;
+    if (! m_result.isNull()) {
+        statusBar()->showMessage(tr("Unwrapped in %1 ms").arg(m_unwrapTime));
 
-            switch (interpolation) {
-            case SettingsDialog::NoInterpolation:
-                rgb = identityInterpolation(sourcePixels, sourceWidth, point);
-                break;
-            case SettingsDialog::BilinearInterpolation:
-                rgb = bilinearInterpolation(sourcePixels, sourceWidth, point);
-                break;
-            case SettingsDialog::BicubicInterpolation:
-                rgb = bicubicInterpolation(sourcePixels, sourceWidth, point);
-                break;
-            default:
-                rgb = qRgb(0, 0, 0);
-            }
+        m_preview.cancel();
+        ui->previewLabel->setVisible(false);
 
-            outputPixels[offset++] = rgb;
+        ui->sourceImage->setShowCircles(false);
+        ui->sourceImage->setImage(m_result);
+        ui->saveImageButton->setEnabled(!m_saveWatcher.isRunning());
 
-            int progress = 100.0 * ((float) offset) / pixels;
-            ui->progressBar->setValue(progress);
-        }
+        ui->action_SaveUnrappedImage->setEnabled(!m_saveWatcher.isRunning());
     }
+}
 
-    if (!m_cancel) {
-        int finalWidth = m_settingsDialog->finalWidth();
-        int finalHeight = m_settingsDialog->finalHeight();
-
-        qreal factor = ((float) (m_settingsDialog->equiRectangular() ? m_settingsDialog->fov() : 180)) / 180.0;
-        int scaledWidth = finalWidth;
-        int scaledHeight = finalHeight * factor;
-
-        QImage finalScaled = output.scaled(QSize(scaledWidth, scaledHeight), Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
-
-        m_result = QImage(QSize(finalWidth, finalHeight), output.format());
-
-        QPainter p(&m_result);
-        p.fillRect(m_result.rect(), m_settingsDialog->equiRectangularFillColor());
-        p.drawImage(QPoint(0, (finalHeight - scaledHeight) / 2), finalScaled);
+void MainWindow::setProcessing(bool processing)
+{
+    ui->loadImageButton->setEnabled(!processing);
+    ui->zoomInButton->setEnabled(!processing);
+    ui->zoomOutButton->setEnabled(!processing);
+    ui->settingsButton->setEnabled(!processing);
+    ui->goBackButton->setEnabled(!processing);
+    ui->processButton->setEnabled(!processing);
+    ui->fullScreenButton->setEnabled(!processing);
+
+    ui->action_ChooseImage->setEnabled(!processing);
+    ui->action_Settings->setEnabled(!processing);
+    ui->action_DetectMirror->setEnabled(!processing && ui->sourceImage->showCircles() && !m_detectWatcher.isRunning());
+    ui->action_Unwrap->setEnabled(!processing);
+
+    if (processing) {
+        ui->action_SaveUnrappedImage->setEnabled(false);
+        ui->progressBar->setValue(0);
     }
 
-    ui->cancelButton->setVisible(false);
-    ui->progressBar->setVisible(false);
+    ui->cancelButton->setVisible(processing);
+    ui->progressBar->setVisible(processing);
 }
 
 void MainWindow::enterFullScreen() {
@@ -245,7 +208,7 @@ void MainWindow::enterFullScreen() {
 }
 
 void MainWindow::saveResultImage() {
-    if (m_result.isNull()) {
+    if (m_result.isNull() || m_saveWatcher.isRunning()) {
         return;
     }
 
@@ -267,13 +230,37 @@ void MainWindow::saveResultImage() {
     settings.setValue("defaultSaveDir", dir);
 
     if (file.suffix().isEmpty()) {
-        path = path.append(".jpg");
+        path = path.append(".").append(m_settingsDialog->outputFormat());
     }
 
-    bool saved = m_result.save(path, 0, 90);
+    m_encoder.setQuality(m_settingsDialog->quality());
+    m_encoder.setCompression(m_settingsDialog->compression());
+    m_encoder.setThreadCount(m_settingsDialog->threadCount());
+
+    ui->saveImageButton->setEnabled(false);
+    ui->action_SaveUnrappedImage->setEnabled(false);
+    statusBar()->showMessage(tr("Saving %1...").arg(QFileInfo(path).fileName()));
+
+    // encodes a copy, so the window can go on with the next image
+    m_saveTimer.start();
+    m_saveWatcher.setFuture(QtConcurrent::run(&m_encoder, &ImageEncoder::save, m_result, path));
+}
+
+void MainWindow::saveFinished()
+{
+    bool saved = m_saveWatcher.result();
+    qint64 saveTime = m_saveTimer.elapsed();
+
+    ui->saveImageButton->setEnabled(!m_result.isNull());
+    ui->action_SaveUnrappedImage->setEnabled(!m_result.isNull() && !m_unwrapWatcher.isRunning());
+
     if (! saved) {
-        QMessageBox::information(QApplication::desktop(), trUtf8("Load 360º Image"), tr("Failed to save image in the specified location."), QMessageBox::NoButton);
+        statusBar()->clearMessage();
+        QMessageBox::information(QApplication::desktop(), tr("Save Image"), tr("Failed to save image in the specified location: %1").arg(m_encoder.errorString()), QMessageBox::NoButton);
+        return;
     }
+
+    statusBar()->showMessage(tr("Unwrapped in %1 ms, saved in %2 ms").arg(m_unwrapTime).arg(saveTime));
 }
 
 void MainWindow::toggleFullScreen() {
@@ -306,13 +293,16 @@ bool MainWindow::event(QEvent *event) {
 
 void MainWindow::cancelProcessing()
 {
-    m_cancel = true;
+    m_unwrapper.cancel();
 }
 
 void MainWindow::setupSourceImage()
 {
+    ui->previewLabel->clear();
+    ui->previewLabel->setVisible(true);
+
     ui->sourceImage->setShowCircles(true);
-    ui->sourceImage->setImage(m_source);
+    ui->sourceImage->setSource(&m_pyramid);
     m_result = QImage();
 
     ui->zoomInButton->setEnabled(true);
@@ -323,5 +313,75 @@ void MainWindow::setupSourceImage()
     ui->saveImageButton->setEnabled(false);
 
     ui->action_Settings->setEnabled(true);
+    ui->action_DetectMirror->setEnabled(!m_detectWatcher.isRunning());
     ui->action_Unwrap->setEnabled(true);
 }
+
+/**
+ * Looks for the mirror in the source in the background, see
+ * detectFinished().
+ */
+void MainWindow::detectMirror()
+{
+    if (m_source.isNull() || !ui->sourceImage->showCircles() || m_detectWatcher.isRunning()) {
+        return;
+    }
+
+    ui->action_DetectMirror->setEnabled(false);
+    statusBar()->showMessage(tr("Detecting mirror..."));
+
+    // the result is dropped if another image is loaded meanwhile
+    m_detectSourceKey = m_source.cacheKey();
+
+    bool (MirrorDetector::*detect)(SourcePyramid*) = &MirrorDetector::detect;
+    m_detectWatcher.setFuture(QtConcurrent::run(&m_detector, detect, &m_pyramid));
+}
+
+/**
+ * Places the circles on the mirror found in the source.
+ */
+void MainWindow::detectFinished()
+{
+    bool found = m_detectWatcher.result();
+
+    if (statusBar()->currentMessage() == tr("Detecting mirror...")) {
+        statusBar()->clearMessage();
+    }
+
+    ui->action_DetectMirror->setEnabled(ui->sourceImage->showCircles() && !m_unwrapWatcher.isRunning());
+
+    if (m_source.cacheKey() != m_detectSourceKey || !ui->sourceImage->showCircles()) {
+        return;
+    }
+
+    if (found) {
+        ui->sourceImage->setCircles(m_detector.center(), m_detector.innerRadius(), m_detector.outerRadius());
+    }
+    else {
+        QMessageBox::information(QApplication::desktop(), tr("Detect Mirror"), tr("No mirror was found in the image."), QMessageBox::NoButton);
+    }
+}
+
+/**
+ * Asks for a preview of the current circles, as wide as the window.
+ */
+void MainWindow::updatePreview()
+{
+    if (m_source.isNull() || !ui->sourceImage->showCircles()) {
+        return;
+    }
+
+    UnwrapParameters parameters = m_settingsDialog->parameters();
+    parameters.center = ui->sourceImage->center();
+    parameters.innerRadius = ui->sourceImage->innerRadius();
+    parameters.outerRadius = ui->sourceImage->outerRadius();
+
+    m_preview.request(parameters, ui->previewLabel->width());
+}
+
+void MainWindow::showPreview(const QImage& image)
+{
+    if (ui->sourceImage->showCircles()) {
+        ui->previewLabel->setPixmap(QPixmap::fromImage(image));
+    }
+}
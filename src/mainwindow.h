@@ -26,6 +26,16 @@
 
 #include <QMainWindow>
 #include <QImage>
+#include <QFutureWatcher>
+#include <QElapsedTimer>
+
+#include "unwrapper.h"
+#include "sourcepyramid.h"
+#include "unwrappreview.h"
+#include "mapcache.h"
+#include "polarbuffer.h"
+#include "imageencoder.h"
+#include "mirrordetector.h"
 
 namespace Ui {
     class MainWindow;
@@ -53,6 +63,12 @@ protected slots:
     void saveResultImage();
     void cancelProcessing();
     void setupSourceImage();
+    void unwrapFinished();
+    void saveFinished();
+    void detectMirror();
+    void detectFinished();
+    void updatePreview();
+    void showPreview(const QImage& image);
 
     void toggleFullScreen();
 
@@ -62,10 +78,25 @@ private:
     SettingsDialog *m_settingsDialog;
 
     QImage m_source;
+    SourcePyramid m_pyramid;
+    UnwrapPreview m_preview;
     QImage m_result;
-    bool m_cancel;
+    MapCache m_mapCache;
+    PolarBuffer m_polar;
+    Unwrapper m_unwrapper;
+    QFutureWatcher<QImage> m_unwrapWatcher;
+    QElapsedTimer m_unwrapTimer;
+    qint64 m_unwrapTime;
+
+    ImageEncoder m_encoder;
+    QFutureWatcher<bool> m_saveWatcher;
+    QElapsedTimer m_saveTimer;
+
+    MirrorDetector m_detector;
+    QFutureWatcher<bool> m_detectWatcher;
+    qint64 m_detectSourceKey;
 
-    void unwrap();
+    void setProcessing(bool processing);
 };
 
 #endif // MAINWINDOW_H
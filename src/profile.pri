@@ -0,0 +1,9 @@
+#
+# Build with gprof instrumentation: qmake CONFIG+=profile
+#
+
+profile {
+    QMAKE_CFLAGS += -pg
+    QMAKE_CXXFLAGS += -pg
+    QMAKE_LFLAGS += -pg
+}
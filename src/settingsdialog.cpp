@@ -24,11 +24,12 @@
 #include <QDebug>
 #include <QPalette>
 #include <QColorDialog>
+#include <QCoreApplication>
 
 #include "settingsdialog.h"
 #include "ui_settingsdialog.h"
-
-#define PI 3.14159265358979323846
+#include "unwrapper.h"
+#include "imageencoder.h"
 
 SettingsDialog::SettingsDialog(QWidget *parent) :
     QDialog(parent),
@@ -36,6 +37,14 @@ SettingsDialog::SettingsDialog(QWidget *parent) :
 {
     ui->setupUi(this);
 
+    // registered samplers show up next to the built in ones
+    foreach (const Sampler* sampler, samplers()) {
+        ui->interpolationComboBox->addItem(QCoreApplication::translate("Sampler", sampler->label),
+                                           sampler->interpolation);
+    }
+    ui->interpolationComboBox->setCurrentIndex(
+            ui->interpolationComboBox->findData(int(Unwrapper::BilinearInterpolation)));
+
     connect(this, SIGNAL(accepted()), SLOT(saveValues()));
     connect(this, SIGNAL(rejected()), SLOT(loadValues()));
 
@@ -60,13 +69,12 @@ int SettingsDialog::focalPointPercent()
 
 int SettingsDialog::resultWidth()
 {
-    qreal focalRadius = m_innerRadius + ((focalPointPercent() / 100.0) * (m_outerRadius - m_innerRadius));
-    return 2 * focalRadius * PI;
+    return Unwrapper::unwrappedSize(m_innerRadius, m_outerRadius, focalPointPercent(), fov()).width();
 }
 
 int SettingsDialog::resultHeight()
 {
-    return (resultWidth() * fov()) / 360; // width = 360 deg
+    return Unwrapper::unwrappedSize(m_innerRadius, m_outerRadius, focalPointPercent(), fov()).height();
 }
 
 int SettingsDialog::finalWidth()
@@ -94,9 +102,67 @@ QColor SettingsDialog::equiRectangularFillColor()
     return Qt::black;
 }
 
-SettingsDialog::ImageInterpolation SettingsDialog::interpolation()
+bool SettingsDialog::singlePass()
+{
+    return ui->singlePassCheckBox->isChecked();
+}
+
+/**
+ * Number of threads used to unwrap. Zero means one per core.
+ */
+int SettingsDialog::threadCount()
+{
+    return ui->threadsSpinBox->value();
+}
+
+/**
+ * Current settings as unwrap parameters. Only the mirror center is left
+ * for the caller to set.
+ */
+UnwrapParameters SettingsDialog::parameters()
 {
-    return (ImageInterpolation) ui->interpolationComboBox->currentIndex();
+    UnwrapParameters p;
+    p.innerRadius = m_innerRadius;
+    p.outerRadius = m_outerRadius;
+    p.fov = fov();
+    p.focalPointPercent = focalPointPercent();
+    p.interpolation = (Unwrapper::Interpolation) interpolation();
+    p.invert = invertFinalImage();
+    p.finalWidth = finalWidth();
+    p.finalHeight = finalHeight();
+    p.equiRectangular = equiRectangular();
+    p.fillColor = equiRectangularFillColor();
+    p.singlePass = singlePass();
+    p.threadCount = threadCount();
+
+    return p;
+}
+
+/**
+ * Extension of the format results are saved in when their name has none.
+ */
+QString SettingsDialog::outputFormat()
+{
+    return ImageEncoder::formats().value(ui->formatComboBox->currentIndex(), "jpg");
+}
+
+int SettingsDialog::quality()
+{
+    return ui->qualitySpinBox->value();
+}
+
+int SettingsDialog::compression()
+{
+    return ui->compressionSpinBox->value();
+}
+
+/**
+ * Unwrapper::Interpolation of the selected sampler.
+ */
+int SettingsDialog::interpolation()
+{
+    int index = ui->interpolationComboBox->currentIndex();
+    return ui->interpolationComboBox->itemData(index).toInt();
 }
 
 void SettingsDialog::updateSizeLabel()
@@ -106,9 +172,7 @@ void SettingsDialog::updateSizeLabel()
 
 void SettingsDialog::updateFinalHeightRatio()
 {
-    int f = equiRectangular() ? 180 : fov();
-
-    int height = (ui->finalWidthSpinBox->value() * f) / 360;
+    int height = Unwrapper::finalHeight(ui->finalWidthSpinBox->value(), fov(), equiRectangular());
     ui->finalHeightSpinBox->blockSignals(true);
     ui->finalHeightSpinBox->setValue(height);
     ui->finalHeightSpinBox->blockSignals(false);
@@ -141,11 +205,23 @@ void SettingsDialog::loadValues()
     m_settings.beginGroup("Processing");
     ui->fovSpinBox->setValue(m_settings.value("fov", fov()).toInt());
     ui->focalPointSpinBox->setValue(m_settings.value("focalPercent", focalPointPercent()).toInt());
-    ui->interpolationComboBox->setCurrentIndex(m_settings.value("interpolationOption", interpolation()).toInt());
+    int sampler = ui->interpolationComboBox->findData(m_settings.value("interpolationOption", interpolation()).toInt());
+    if (sampler >= 0) {
+        ui->interpolationComboBox->setCurrentIndex(sampler);
+    }
     ui->equiRectCheckBox->setChecked(m_settings.value("equiRectangular", equiRectangular()).toBool());
     ui->finalHeightSpinBox->setValue(m_settings.value("finalHeight", finalHeight()).toInt());
     ui->finalWidthSpinBox->setValue(m_settings.value("finalWidth", finalWidth()).toInt());
     ui->skyUpCheckbox->setChecked(m_settings.value("invert", invertFinalImage()).toBool());
+    ui->threadsSpinBox->setValue(m_settings.value("threads", threadCount()).toInt());
+    ui->singlePassCheckBox->setChecked(m_settings.value("singlePass", singlePass()).toBool());
+    m_settings.endGroup();
+
+    m_settings.beginGroup("Output");
+    int format = ImageEncoder::formats().indexOf(m_settings.value("format", outputFormat()).toString());
+    ui->formatComboBox->setCurrentIndex(qMax(0, format));
+    ui->qualitySpinBox->setValue(m_settings.value("quality", quality()).toInt());
+    ui->compressionSpinBox->setValue(m_settings.value("compression", compression()).toInt());
     m_settings.endGroup();
 }
 
@@ -154,10 +230,18 @@ void SettingsDialog::saveValues()
     m_settings.beginGroup("Processing");
     m_settings.setValue("fov", fov());
     m_settings.setValue("focalPercent", focalPointPercent());
-    m_settings.setValue("interpolationOption", (int) interpolation());
+    m_settings.setValue("interpolationOption", interpolation());
     m_settings.setValue("equiRectangular", equiRectangular());
     m_settings.setValue("finalHeight", finalHeight());
     m_settings.setValue("finalWidth", finalWidth());
     m_settings.setValue("invert", invertFinalImage());
+    m_settings.setValue("threads", threadCount());
+    m_settings.setValue("singlePass", singlePass());
+    m_settings.endGroup();
+
+    m_settings.beginGroup("Output");
+    m_settings.setValue("format", outputFormat());
+    m_settings.setValue("quality", quality());
+    m_settings.setValue("compression", compression());
     m_settings.endGroup();
 }
@@ -27,6 +27,8 @@
 #include <QDialog>
 #include <QSettings>
 
+struct UnwrapParameters;
+
 namespace Ui {
     class SettingsDialog;
 }
@@ -39,22 +41,22 @@ public:
     explicit SettingsDialog(QWidget *parent = 0);
     ~SettingsDialog();
 
-    enum ImageInterpolation {
-        NoInterpolation = 0,
-        BilinearInterpolation,
-        BicubicInterpolation
-    };
-
     int fov();
     int focalPointPercent();
     int resultWidth();
     int resultHeight();
     int finalWidth();
     int finalHeight();
-    ImageInterpolation interpolation();
+    int interpolation();
     bool invertFinalImage();
     bool equiRectangular();
     QColor equiRectangularFillColor();
+    bool singlePass();
+    int threadCount();
+    UnwrapParameters parameters();
+    QString outputFormat();
+    int quality();
+    int compression();
 
 public slots:
     void setInnerRadius(qreal radius);
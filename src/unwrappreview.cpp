@@ -0,0 +1,118 @@
+/******************************************************************************
+ *
+ * Copyright (c) 2010 Cláudio F. Gil <claudio.f.gil@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+#include <QtConcurrentRun>
+
+#include "unwrappreview.h"
+#include "sourcepyramid.h"
+
+UnwrapPreview::UnwrapPreview(QObject *parent) :
+    QObject(parent),
+    m_source(0),
+    m_hasPending(false),
+    m_generation(0),
+    m_runningGeneration(0)
+{
+    m_timer.setSingleShot(true);
+    m_timer.setInterval(Delay);
+
+    connect(&m_timer, SIGNAL(timeout()), SLOT(start()));
+    connect(&m_watcher, SIGNAL(finished()), SLOT(finished()));
+}
+
+UnwrapPreview::~UnwrapPreview()
+{
+    cancel();
+    m_watcher.waitForFinished();
+}
+
+void UnwrapPreview::setSource(SourcePyramid* source)
+{
+    cancel();
+    m_source = source;
+}
+
+/**
+ * Asks for a preview width pixels wide, or MaxWidth if narrower, of the
+ * unwrap parameters describe. Previews of earlier requests not started yet
+ * are dropped.
+ */
+void UnwrapPreview::request(const UnwrapParameters& parameters, int width)
+{
+    UnwrapParameters p = parameters;
+    width = qBound(1, width, int(MaxWidth));
+
+    if (p.finalHeight > 0) {
+        p.finalHeight = qMax(1, p.finalHeight * width / p.finalWidth);
+    }
+
+    p.finalWidth = width;
+    p.singlePass = true;
+    p.interpolation = Unwrapper::BilinearInterpolation;
+
+    m_pending = p;
+    m_hasPending = true;
+
+    if (!m_timer.isActive() && !m_watcher.isRunning()) {
+        m_timer.start();
+    }
+}
+
+/**
+ * Drops the pending request and stops the running preview, whose result is
+ * then never shown.
+ */
+void UnwrapPreview::cancel()
+{
+    m_generation++;
+    m_hasPending = false;
+    m_timer.stop();
+    m_unwrapper.cancel();
+}
+
+void UnwrapPreview::start()
+{
+    if (!m_hasPending || !m_source || m_watcher.isRunning()) {
+        return;
+    }
+
+    m_hasPending = false;
+    m_runningGeneration = m_generation;
+
+    m_unwrapper.setParameters(m_pending);
+    m_unwrapper.setCanceled(false);
+
+    QImage (Unwrapper::*unwrap)(SourcePyramid*) = &Unwrapper::unwrap;
+    m_watcher.setFuture(QtConcurrent::run(&m_unwrapper, unwrap, m_source));
+}
+
+void UnwrapPreview::finished()
+{
+    // it may have completed just before being canceled
+    QImage image = m_watcher.result();
+    if (!image.isNull() && m_runningGeneration == m_generation) {
+        emit previewReady(image);
+    }
+
+    // the latest request that came in meanwhile
+    start();
+}
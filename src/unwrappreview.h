@@ -0,0 +1,82 @@
+/******************************************************************************
+ *
+ * Copyright (c) 2010 Cláudio F. Gil <claudio.f.gil@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *****************************************************************************/
+#ifndef UNWRAPPREVIEW_H
+#define UNWRAPPREVIEW_H
+
+#include <QObject>
+#include <QImage>
+#include <QTimer>
+#include <QFutureWatcher>
+
+#include "unwrapper.h"
+
+class SourcePyramid;
+
+/**
+ * Renders small unwraps in the background while the circles are moved.
+ *
+ * Requests arriving within Delay milliseconds are merged, and while one
+ * preview renders only the latest request is kept, so the previews follow
+ * the markers at the rate they can be rendered. They are sampled in a
+ * single pass from a small level of the source pyramid. A preview running
+ * when cancel() is called is dropped even if it completes.
+ */
+class UnwrapPreview : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit UnwrapPreview(QObject *parent = 0);
+    ~UnwrapPreview();
+
+    enum {
+        MaxWidth = 1024,
+        Delay = 15
+    };
+
+    void setSource(SourcePyramid* source);
+    void request(const UnwrapParameters& parameters, int width);
+
+public slots:
+    void cancel();
+
+signals:
+    void previewReady(const QImage& image);
+
+private slots:
+    void start();
+    void finished();
+
+private:
+    SourcePyramid* m_source;
+    Unwrapper m_unwrapper;
+    QFutureWatcher<QImage> m_watcher;
+    QTimer m_timer;
+
+    UnwrapParameters m_pending;
+    bool m_hasPending;
+    int m_generation;
+    int m_runningGeneration;
+};
+
+#endif // UNWRAPPREVIEW_H